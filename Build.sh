@@ -13,12 +13,16 @@ if [ "$1" == "debug" ]; then
 elif [ "$1" == "release" ]; then
     echo "--- Building in release mode ---"
     comp_opts="$comp_opts $release_opts"
+elif [ "$1" == "bench" ]; then
+    echo "--- Building in release mode for benchmarking ---"
+    comp_opts="$comp_opts $release_opts"
+    bench=1
 elif [ "$1" == "run" ]; then
     echo "--- Running $program_name ---"
     $build_dir/$program_name $2
     exit $?
 else
-    echo "Invalid command. Use 'debug', 'release' or 'run'"
+    echo "Invalid command. Use 'debug', 'release', 'bench' or 'run'"
     exit -1
 fi
 
@@ -28,6 +32,17 @@ fi
 
 echo "--- Building $program_name ---"
 echo "$comp_opts $sources $link_opts"
-musl-gcc $comp_opts $sources $link_opts -o $build_dir/$program_name
+musl-gcc $comp_opts $sources $link_opts -o $build_dir/$program_name || exit $?
+
+echo "--- Building ${program_name}Worker ---"
+musl-gcc $comp_opts ./Src/Worker.c -o $build_dir/${program_name}Worker || exit $?
+
+if [ "$bench" == "1" ]; then
+    echo "--- Building ${program_name}Bench ---"
+    musl-gcc $comp_opts ./Src/Bench.c -o $build_dir/${program_name}Bench || exit $?
+
+    echo "--- Running ${program_name}Bench ---"
+    $build_dir/${program_name}Bench $build_dir/$program_name "${@:2}"
+fi
 
 exit $?
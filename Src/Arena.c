@@ -0,0 +1,60 @@
+// Bump allocator for everything that lives as long as a build, it's all released at once with 'DestroyArena()'
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT 16
+#define ARENA_ALIGN(size) (((size) + ARENA_ALIGNMENT - 1) & ~((size_t) ARENA_ALIGNMENT - 1))
+
+typedef struct Arena_Block {
+	struct Arena_Block* next;
+	size_t size;
+	size_t used;
+} Arena_Block;
+
+typedef struct Arena {
+	Arena_Block* head;
+} Arena;
+
+void* ArenaAlloc(Arena* arena, size_t size)
+{
+	size = ARENA_ALIGN(size);
+
+	Arena_Block* block = arena->head;
+	if (block == NULL || block->size - block->used < size) {
+		size_t blockSize = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+		block = (Arena_Block*) malloc(ARENA_ALIGN(sizeof(Arena_Block)) + blockSize);
+		if (block == NULL)
+			return NULL;
+
+		block->next = arena->head;
+		block->size = blockSize;
+		block->used = 0;
+		arena->head = block;
+	}
+
+	// The header is padded, so every allocation keeps the alignment
+	void* ptr = (char*) block + ARENA_ALIGN(sizeof(Arena_Block)) + block->used;
+	block->used += size;
+
+	return ptr;
+}
+
+char* ArenaStrDup(Arena* arena, const char* str, size_t len)
+{
+	char* dup = (char*) ArenaAlloc(arena, len + 1);
+	memcpy(dup, str, len);
+	dup[len] = '\0';
+
+	return dup;
+}
+
+void DestroyArena(Arena* arena)
+{
+	Arena_Block* block = arena->head;
+	while (block != NULL) {
+		Arena_Block* next = block->next;
+		free(block);
+		block = next;
+	}
+
+	arena->head = NULL;
+}
@@ -0,0 +1,436 @@
+// Measures CBuilder's own overhead on a synthetic project, the compiler is replaced by a stub that only touches its outputs.
+// Usage:
+//	CBuilderBench <path/to/CBuilder> [--files N] [--depth D] [--fanout F] [--headers H] [--runs R] [--dir path]
+//	CBuilderBench --stub <compiler args>
+
+#define _GNU_SOURCE
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <unistd.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define StrLen(str) strlen(str)
+#define StrCmp(s1, s2) (strcmp(s1, s2) == 0)
+
+typedef struct Bench_Config {
+	size_t files;
+	size_t depth;
+	size_t fanout;
+	size_t headers;
+	size_t runs;
+	char* dir;
+	char* cbuilder;
+	char* self;
+} Bench_Config;
+
+typedef struct Bench_Run {
+	double wallMs;
+	double parseMs;
+	double scanMs;
+	double compileMs;
+	double linkMs;
+} Bench_Run;
+
+static uint64_t GetTimeUs()
+{
+	struct timespec ts = {0};
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000ull + (uint64_t) ts.tv_nsec / 1000ull;
+}
+
+static void TouchFile(char* path)
+{
+	FILE* file = fopen(path, "w");
+	if (file != NULL)
+		fclose(file);
+}
+
+#define STUB_MAX_INCLUDE_DIRS 16
+
+// Lists the source and every '#include "..."' it names that resolves next to it or in an '-I' dir,
+// like '-MMD' would, so CBuilder stats the same headers as with a real compiler
+static void WriteDepFile(char* objPath, char* depPath, char* source, char** includeDirs, size_t includeDirCount)
+{
+	char defaultPath[PATH_MAX] = {0};
+	if (depPath == NULL) {
+		snprintf(defaultPath, sizeof(defaultPath), "%.*s.d", (int) (StrLen(objPath) - 2), objPath);
+		depPath = defaultPath;
+	}
+
+	FILE* file = fopen(depPath, "w");
+	if (file == NULL)
+		return;
+	fprintf(file, "%s: %s", objPath, source);
+
+	FILE* sourceFile = fopen(source, "r");
+	char* sourceName = strrchr(source, '/');
+	int sourceDirLen = (sourceName != NULL) ? (int) (sourceName - source) : 1;
+	char* sourceDir = (sourceName != NULL) ? source : ".";
+
+	char line[PATH_MAX] = {0};
+	while (sourceFile != NULL && fgets(line, sizeof(line), sourceFile) != NULL) {
+		if (strncmp(line, "#include \"", 10) != 0)
+			continue;
+		char* name = &line[10];
+		char* nameEnd = strchr(name, '"');
+		if (nameEnd == NULL)
+			continue;
+		*nameEnd = '\0';
+
+		char headerPath[PATH_MAX] = {0};
+		struct stat headerInfo = {0};
+		bool found = (size_t) snprintf(headerPath, sizeof(headerPath), "%.*s/%s", sourceDirLen, sourceDir, name) < sizeof(headerPath)
+			&& stat(headerPath, &headerInfo) == 0;
+		for (size_t i = 0; i < includeDirCount && !found; i += 1) {
+			found = (size_t) snprintf(headerPath, sizeof(headerPath), "%s/%s", includeDirs[i], name) < sizeof(headerPath)
+				&& stat(headerPath, &headerInfo) == 0;
+		}
+		if (found)
+			fprintf(file, " \\\n  %s", headerPath);
+	}
+
+	fprintf(file, "\n");
+	if (sourceFile != NULL)
+		fclose(sourceFile);
+	fclose(file);
+}
+
+// Behaves like 'cc -c [-I dir] [-MMD] [-MF dep] src [-o obj]' and 'cc -o exe objs', without doing any work
+int RunStub(int argc, char* argv[])
+{
+	char* output = NULL;
+	bool depFile = false;
+	char* depPath = NULL;
+	char* includeDirs[STUB_MAX_INCLUDE_DIRS] = {0};
+	size_t includeDirCount = 0;
+	for (int i = 0; i < argc; i += 1) {
+		if (StrCmp(argv[i], "-o") && i + 1 < argc) {
+			output = argv[i + 1];
+		} else if (StrCmp(argv[i], "-MMD")) {
+			depFile = true;
+		} else if (StrCmp(argv[i], "-MF") && i + 1 < argc) {
+			depPath = argv[i + 1];
+		} else if (strncmp(argv[i], "-I", 2) == 0 && includeDirCount < STUB_MAX_INCLUDE_DIRS) {
+			char* dir = (argv[i][2] != '\0') ? &argv[i][2] : (i + 1 < argc ? argv[i + 1] : NULL);
+			if (dir != NULL) {
+				includeDirs[includeDirCount] = dir;
+				includeDirCount += 1;
+			}
+		}
+	}
+
+	for (int i = 0; i < argc; i += 1) {
+		char* arg = argv[i];
+		size_t argLen = StrLen(arg);
+		if (argLen < 3 || !StrCmp(&arg[argLen - 2], ".c"))
+			continue;
+
+		if (output != NULL) {
+			TouchFile(output);
+			if (depFile)
+				WriteDepFile(output, depPath, arg, includeDirs, includeDirCount);
+			return 0;
+		}
+
+		char* name = strrchr(arg, '/');
+		name = (name != NULL) ? name + 1 : arg;
+
+		char objPath[PATH_MAX] = {0};
+		snprintf(objPath, sizeof(objPath), "%.*s.o", (int) (StrLen(name) - 2), name);
+		TouchFile(objPath);
+		if (depFile)
+			WriteDepFile(objPath, depPath, arg, includeDirs, includeDirCount);
+	}
+
+	// A link, there is no source to compile
+	if (output != NULL)
+		TouchFile(output);
+
+	return 0;
+}
+
+static void MakeDir(char* path)
+{
+	mkdir(path, 0755);
+}
+
+static size_t GenerateDirs(Bench_Config* config, char* path, size_t level, char** dirs, size_t dirCount)
+{
+	dirs[dirCount] = strdup(path);
+	dirCount += 1;
+
+	if (level >= config->depth)
+		return dirCount;
+
+	for (size_t i = 0; i < config->fanout; i += 1) {
+		char subDir[PATH_MAX] = {0};
+		snprintf(subDir, sizeof(subDir), "%s/d%zu", path, i);
+		MakeDir(subDir);
+		dirCount = GenerateDirs(config, subDir, level + 1, dirs, dirCount);
+	}
+
+	return dirCount;
+}
+
+bool GenerateProject(Bench_Config* config)
+{
+	char path[PATH_MAX] = {0};
+	MakeDir(config->dir);
+
+	snprintf(path, sizeof(path), "%s/Include", config->dir);
+	MakeDir(path);
+	for (size_t i = 0; i < config->headers; i += 1) {
+		snprintf(path, sizeof(path), "%s/Include/header_%zu.h", config->dir, i);
+		FILE* file = fopen(path, "w");
+		if (file == NULL)
+			return false;
+		fprintf(file, "#pragma once\nint Header%zu(int x);\n", i);
+		fclose(file);
+	}
+
+	size_t maxDirs = 1;
+	size_t levelDirs = 1;
+	for (size_t i = 0; i < config->depth; i += 1) {
+		levelDirs *= config->fanout;
+		maxDirs += levelDirs;
+	}
+
+	char** dirs = (char**) malloc(sizeof(char*) * maxDirs);
+	snprintf(path, sizeof(path), "%s/Src", config->dir);
+	MakeDir(path);
+	size_t dirCount = GenerateDirs(config, path, 0, dirs, 0);
+
+	for (size_t i = 0; i < config->files; i += 1) {
+		snprintf(path, sizeof(path), "%s/unit_%zu.c", dirs[i % dirCount], i);
+		FILE* file = fopen(path, "w");
+		if (file == NULL)
+			return false;
+
+		for (size_t j = 0; j < config->headers; j += 1)
+			fprintf(file, "#include \"header_%zu.h\"\n", j);
+		fprintf(file, "int Unit%zu(int x) { return x + %zu; }\n", i, i);
+		fclose(file);
+	}
+
+	for (size_t i = 0; i < dirCount; i += 1)
+		free(dirs[i]);
+	free(dirs);
+
+	snprintf(path, sizeof(path), "%s/Build.ini", config->dir);
+	FILE* file = fopen(path, "w");
+	if (file == NULL)
+		return false;
+
+	fprintf(file,
+		"[Program]\n"
+		"sources = ./Src/**.c\n"
+		"output = ./.Build/Bench\n"
+		"[Program.Linux]\n"
+		"compiler = %s --stub\n"
+		"sysLibs = c\n"
+		"compFlags = -I../Include\n"
+		"linkFlags = -s\n",
+		config->self
+	);
+	fclose(file);
+
+	snprintf(path, sizeof(path), "%s/.Build", config->dir);
+	MakeDir(path);
+
+	return true;
+}
+
+// Reads the duration of a phase back from the trace written by CBuilder
+static double GetPhaseMs(char* traceData, char* phase)
+{
+	char key[128] = {0};
+	snprintf(key, sizeof(key), "{\"name\":\"%s\",\"cat\":\"phase\"", phase);
+
+	char* event = strstr(traceData, key);
+	if (event == NULL)
+		return 0.0;
+
+	char* dur = strstr(event, "\"dur\":");
+	if (dur == NULL)
+		return 0.0;
+
+	return strtod(dur + sizeof("\"dur\":") - 1, NULL) / 1000.0;
+}
+
+bool RunCBuilder(Bench_Config* config, Bench_Run* run)
+{
+	char tracePath[PATH_MAX] = {0};
+	snprintf(tracePath, sizeof(tracePath), "%s/.Build/trace.json", config->dir);
+
+	fflush(stdout);
+	uint64_t start = GetTimeUs();
+	pid_t pid = fork();
+	if (pid == 0) {
+		if (chdir(config->dir) != 0)
+			_exit(127);
+		freopen("/dev/null", "w", stdout);
+		execl(config->cbuilder, config->cbuilder, "--trace", tracePath, "Build.ini", (char*) NULL);
+		_exit(127);
+	}
+
+	int status = 0;
+	if (pid == -1 || waitpid(pid, &status, 0) == -1)
+		return false;
+	run->wallMs = (double) (GetTimeUs() - start) / 1000.0;
+
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		fprintf(stderr, "CBuilder failed with status %d\n", status);
+		return false;
+	}
+
+	FILE* file = fopen(tracePath, "r");
+	if (file == NULL)
+		return false;
+
+	fseek(file, 0, SEEK_END);
+	size_t fileSize = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	char* traceData = (char*) malloc(fileSize + 1);
+	traceData[fread(traceData, 1, fileSize, file)] = '\0';
+	fclose(file);
+
+	run->parseMs = GetPhaseMs(traceData, "Parse build file");
+	run->scanMs = GetPhaseMs(traceData, "Expand sources");
+	run->compileMs = GetPhaseMs(traceData, "Compile");
+	run->linkMs = GetPhaseMs(traceData, "Link");
+
+	free(traceData);
+
+	return true;
+}
+
+static int CompareDouble(const void* a, const void* b)
+{
+	double valA = *(const double*) a;
+	double valB = *(const double*) b;
+
+	return (valA > valB) - (valA < valB);
+}
+
+static double Median(double* values, size_t count)
+{
+	qsort(values, count, sizeof(double), CompareDouble);
+	return values[count / 2];
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc >= 2 && StrCmp(argv[1], "--stub"))
+		return RunStub(argc - 2, &argv[2]);
+
+	Bench_Config config = {
+		.files = 1000,
+		.depth = 3,
+		.fanout = 4,
+		.headers = 8,
+		.runs = 5,
+		.dir = "./.Build/BenchTree",
+	};
+
+	for (int i = 1; i < argc; i += 1) {
+		char* arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (StrCmp(arg, "--files") && hasValue)
+			config.files = strtoull(argv[++i], NULL, 10);
+		else if (StrCmp(arg, "--depth") && hasValue)
+			config.depth = strtoull(argv[++i], NULL, 10);
+		else if (StrCmp(arg, "--fanout") && hasValue)
+			config.fanout = strtoull(argv[++i], NULL, 10);
+		else if (StrCmp(arg, "--headers") && hasValue)
+			config.headers = strtoull(argv[++i], NULL, 10);
+		else if (StrCmp(arg, "--runs") && hasValue)
+			config.runs = strtoull(argv[++i], NULL, 10);
+		else if (StrCmp(arg, "--dir") && hasValue)
+			config.dir = argv[++i];
+		else
+			config.cbuilder = arg;
+	}
+
+	if (config.cbuilder == NULL || config.runs == 0) {
+		fprintf(stderr, "Usage: CBuilderBench <path/to/CBuilder> [--files N] [--depth D] [--fanout F] [--headers H] [--runs R] [--dir path]\n");
+		return -1;
+	}
+
+	char cbuilderPath[PATH_MAX] = {0};
+	char selfPath[PATH_MAX] = {0};
+	if (realpath(config.cbuilder, cbuilderPath) == NULL || realpath("/proc/self/exe", selfPath) == NULL) {
+		fprintf(stderr, "Invalid CBuilder path '%s'\n", config.cbuilder);
+		return -1;
+	}
+	config.cbuilder = cbuilderPath;
+	config.self = selfPath;
+
+	printf("Generating %zu files (depth %zu, fan-out %zu, %zu headers per file) in '%s'\n",
+		config.files, config.depth, config.fanout, config.headers, config.dir);
+	if (!GenerateProject(&config)) {
+		fprintf(stderr, "Error trying to generate the project\n");
+		return -1;
+	}
+
+	char dirPath[PATH_MAX] = {0};
+	realpath(config.dir, dirPath);
+	config.dir = dirPath;
+
+	double* fullMs = (double*) malloc(sizeof(double) * config.runs);
+	double* noopMs = (double*) malloc(sizeof(double) * config.runs);
+	double* scanMs = (double*) malloc(sizeof(double) * config.runs);
+	double* parseMs = (double*) malloc(sizeof(double) * config.runs);
+	double* jobsPerSec = (double*) malloc(sizeof(double) * config.runs);
+
+	char objDir[PATH_MAX + 16] = {0};
+	snprintf(objDir, sizeof(objDir), "%s/.Build", config.dir);
+
+	for (size_t i = 0; i < config.runs; i += 1) {
+		// Full build: every object is gone, so every unit gets spawned
+		char cleanCmd[PATH_MAX + 64] = {0};
+		snprintf(cleanCmd, sizeof(cleanCmd), "find '%s' -name '*.o' -delete", objDir);
+		if (system(cleanCmd) != 0)
+			return -1;
+
+		Bench_Run full = {0};
+		if (!RunCBuilder(&config, &full))
+			return -1;
+
+		// No-op build: nothing changed since the previous run
+		Bench_Run noop = {0};
+		if (!RunCBuilder(&config, &noop))
+			return -1;
+
+		fullMs[i] = full.wallMs;
+		noopMs[i] = noop.wallMs;
+		scanMs[i] = full.scanMs;
+		parseMs[i] = full.parseMs;
+		jobsPerSec[i] = full.compileMs > 0.0 ? (double) config.files / (full.compileMs / 1000.0) : 0.0;
+	}
+
+	printf("--- Bench results (median of %zu runs) ---\n", config.runs);
+	printf("Parse build file: %10.3f ms\n", Median(parseMs, config.runs));
+	printf("Source scan:      %10.3f ms\n", Median(scanMs, config.runs));
+	printf("Spawn rate:       %10.1f jobs/s\n", Median(jobsPerSec, config.runs));
+	printf("Full build:       %10.3f ms\n", Median(fullMs, config.runs));
+	printf("No-op build:      %10.3f ms\n", Median(noopMs, config.runs));
+
+	free(jobsPerSec);
+	free(parseMs);
+	free(scanMs);
+	free(noopMs);
+	free(fullMs);
+
+	return 0;
+}
@@ -0,0 +1,247 @@
+// Compilation database for clangd and other tooling, one entry per compile job.
+// Entries are kept one per line, so the previous file can be compared entry by entry.
+
+#define COMPDB_FILE_NAME "compile_commands.json"
+
+static size_t _AppendCompDbRaw(char* dst, size_t offset, const char* str)
+{
+	size_t len = StrLen(str);
+	if (dst != NULL)
+		MemCpy(&dst[offset], str, len);
+
+	return offset + len;
+}
+
+// Same escaping as 'WriteJsonString()', measures only when 'dst' is NULL
+static size_t _AppendCompDbString(char* dst, size_t offset, const char* str)
+{
+	for (size_t i = 0; str[i] != '\0'; i += 1) {
+		char c = str[i];
+		if (c == '\"' || c == '\\') {
+			if (dst != NULL) {
+				dst[offset] = '\\';
+				dst[offset + 1] = c;
+			}
+			offset += 2;
+		} else if ((unsigned char) c < 0x20) {
+			if (dst != NULL)
+				snprintf(&dst[offset], 7, "\\u%04x", (unsigned int) c);
+			offset += 6;
+		} else {
+			if (dst != NULL)
+				dst[offset] = c;
+			offset += 1;
+		}
+	}
+
+	return offset;
+}
+
+static size_t _FormatCompDbEntry(char* dst, char* directory, char* command, char* file)
+{
+	size_t offset = _AppendCompDbRaw(dst, 0, "{\"directory\": \"");
+	offset = _AppendCompDbString(dst, offset, directory);
+	offset = _AppendCompDbRaw(dst, offset, "\", \"command\": \"");
+	offset = _AppendCompDbString(dst, offset, command);
+	offset = _AppendCompDbRaw(dst, offset, "\", \"file\": \"");
+	offset = _AppendCompDbString(dst, offset, file);
+	offset = _AppendCompDbRaw(dst, offset, "\"}");
+
+	return offset;
+}
+
+// Moves 'cursor' past the next entry of a previous database, NULL when there are no more
+static char* _NextCompDbEntry(char** cursor, size_t* entryLen)
+{
+	char* line = *cursor;
+	while (line != NULL && *line != '\0') {
+		char* lineEnd = strchr(line, '\n');
+		char* next = lineEnd != NULL ? lineEnd + 1 : NULL;
+		if (lineEnd == NULL)
+			lineEnd = &line[StrLen(line)];
+
+		if (line[0] == '{') {
+			if (lineEnd > line && lineEnd[-1] == ',')
+				lineEnd -= 1;
+
+			*cursor = next;
+			*entryLen = (size_t) (lineEnd - line);
+			return line;
+		}
+
+		line = next;
+	}
+
+	*cursor = NULL;
+	return NULL;
+}
+
+// An entry is known by its file and the directory it's compiled in
+typedef struct CompDb_Key {
+	char* directory;
+	size_t directoryLen;
+	char* file;
+	size_t fileLen;
+} CompDb_Key;
+
+// The escaped value of '"<field>": "' up to its closing quote, an escaped string has no unescaped quote inside
+static char* _FindCompDbField(char* entry, size_t entryLen, const char* field, size_t* valueLen)
+{
+	size_t fieldLen = StrLen(field);
+	for (size_t i = 0; i + fieldLen <= entryLen; i += 1) {
+		if (!MemCmp(&entry[i], field, fieldLen))
+			continue;
+
+		char* value = &entry[i + fieldLen];
+		size_t len = 0;
+		while (&value[len] < &entry[entryLen] && value[len] != '\"')
+			len += (value[len] == '\\') ? 2 : 1;
+		if (&value[len] >= &entry[entryLen])
+			return NULL;
+
+		*valueLen = len;
+		return value;
+	}
+
+	return NULL;
+}
+
+static bool _GetCompDbKey(char* entry, size_t entryLen, CompDb_Key* key)
+{
+	key->directory = _FindCompDbField(entry, entryLen, "{\"directory\": \"", &key->directoryLen);
+	key->file = _FindCompDbField(entry, entryLen, ", \"file\": \"", &key->fileLen);
+
+	return key->directory != NULL && key->file != NULL;
+}
+
+static uint64_t _HashCompDbKey(CompDb_Key* key)
+{
+	uint64_t hash = HashStr(key->directory, key->directoryLen, HASH_SEED);
+	return HashStr(key->file, key->fileLen, hash) | 1;
+}
+
+static bool _SameCompDbKey(CompDb_Key* a, CompDb_Key* b)
+{
+	return a->directoryLen == b->directoryLen && a->fileLen == b->fileLen &&
+		MemCmp(a->directory, b->directory, a->directoryLen) && MemCmp(a->file, b->file, a->fileLen);
+}
+
+// Entries are matched to the previous file by file and directory, not by position. One that kept its command stays
+// byte for byte where it was, a changed one is replaced in place, a new one goes at the end and a gone one is dropped.
+// Leaves the file untouched when no entry changed, so tools watching it don't reload for nothing.
+bool WriteCompileDb(Arena* arena, Job* jobs, size_t jobCount, char* directory, char* path, size_t* changedEntries)
+{
+	Mapped_File oldData = {0};
+	bool hasOld = IsFileValid(path) && MapFile(path, &oldData);
+
+	// The previous entries, in a table of their key hashes pointing at them. Zero marks a free slot.
+	Str_List oldEntries = {0};
+	char* oldCursor = hasOld ? oldData.data : NULL;
+	size_t oldLen = 0;
+	char* oldEntry = NULL;
+	while ((oldEntry = _NextCompDbEntry(&oldCursor, &oldLen)) != NULL)
+		PushStrList(arena, &oldEntries, oldEntry, oldLen);
+
+	size_t capacity = 16;
+	while (capacity < (oldEntries.size + jobCount) * 2)
+		capacity *= 2;
+	uint64_t* slotHashes = (uint64_t*) ArenaAlloc(arena, sizeof(uint64_t) * capacity);
+	size_t* slotEntries = (size_t*) ArenaAlloc(arena, sizeof(size_t) * capacity);
+	MemZero(slotHashes, sizeof(uint64_t) * capacity);
+
+	CompDb_Key* oldKeys = (CompDb_Key*) ArenaAlloc(arena, sizeof(CompDb_Key) * (oldEntries.size + 1));
+	// What each previous entry becomes, 'SIZE_MAX' while no job claimed it
+	size_t* oldMatches = (size_t*) ArenaAlloc(arena, sizeof(size_t) * (oldEntries.size + 1));
+	size_t changed = 0;
+	for (size_t i = 0; i < oldEntries.size; i += 1) {
+		oldMatches[i] = SIZE_MAX;
+		if (!_GetCompDbKey(GetStrList(&oldEntries, i), oldEntries.lengths[i], &oldKeys[i])) {
+			changed += 1;
+			continue;
+		}
+
+		uint64_t hash = _HashCompDbKey(&oldKeys[i]);
+		size_t slot = (size_t) hash & (capacity - 1);
+		while (slotHashes[slot] != 0)
+			slot = (slot + 1) & (capacity - 1);
+		slotHashes[slot] = hash;
+		slotEntries[slot] = i;
+	}
+
+	Str_List entries = {0};
+	bool* isNew = (bool*) ArenaAlloc(arena, sizeof(bool) * (jobCount + 1));
+	char* scratch = NULL;
+	size_t scratchSize = 0;
+	for (size_t i = 0; i < jobCount; i += 1) {
+		Job* job = &jobs[i];
+
+		size_t entryLen = _FormatCompDbEntry(NULL, directory, job->cmd, job->name);
+		if (entryLen > scratchSize) {
+			scratchSize = entryLen * 2;
+			scratch = (char*) realloc(scratch, scratchSize);
+		}
+		_FormatCompDbEntry(scratch, directory, job->cmd, job->name);
+		PushStrList(arena, &entries, scratch, entryLen);
+
+		CompDb_Key key = {0};
+		_GetCompDbKey(scratch, entryLen, &key);
+		uint64_t hash = _HashCompDbKey(&key);
+		size_t match = SIZE_MAX;
+		for (size_t slot = (size_t) hash & (capacity - 1); slotHashes[slot] != 0 && match == SIZE_MAX; slot = (slot + 1) & (capacity - 1)) {
+			size_t candidate = slotEntries[slot];
+			if (slotHashes[slot] == hash && oldMatches[candidate] == SIZE_MAX && _SameCompDbKey(&oldKeys[candidate], &key))
+				match = candidate;
+		}
+
+		isNew[i] = match == SIZE_MAX;
+		if (isNew[i]) {
+			changed += 1;
+			continue;
+		}
+
+		oldMatches[match] = i;
+		if (oldEntries.lengths[match] != entryLen || !MemCmp(GetStrList(&oldEntries, match), scratch, entryLen))
+			changed += 1;
+	}
+	free(scratch);
+
+	// Entries that are gone count as changes too
+	for (size_t i = 0; i < oldEntries.size; i += 1) {
+		if (oldMatches[i] == SIZE_MAX && oldKeys[i].file != NULL && oldKeys[i].directory != NULL)
+			changed += 1;
+	}
+
+	*changedEntries = changed;
+	if (hasOld)
+		UnmapFile(&oldData);
+	if (hasOld && changed == 0)
+		return true;
+
+	FILE* file = fopen(path, "w");
+	if (file == NULL)
+		return false;
+
+	fputs("[", file);
+	const char* separator = "\n";
+	for (size_t i = 0; i < oldEntries.size; i += 1) {
+		if (oldMatches[i] == SIZE_MAX)
+			continue;
+
+		size_t entry = oldMatches[i];
+		fputs(separator, file);
+		fwrite(GetStrList(&entries, entry), 1, entries.lengths[entry], file);
+		separator = ",\n";
+	}
+	for (size_t i = 0; i < entries.size; i += 1) {
+		if (!isNew[i])
+			continue;
+
+		fputs(separator, file);
+		fwrite(GetStrList(&entries, i), 1, entries.lengths[i], file);
+		separator = ",\n";
+	}
+	fputs("\n]\n", file);
+
+	bool written = !ferror(file);
+	return (fclose(file) == 0) && written;
+}
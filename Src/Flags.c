@@ -0,0 +1,181 @@
+// Per-glob compile flags: a '[Flags:Src/simd/**.c]' section appends its 'compFlags' to the program ones
+// for every source matching the pattern, patterns work like the ones in 'sources'.
+// Every distinct combination is built once, the jobs sharing it point to the same string.
+
+#define FLAGS_MAX_OVERRIDES 64
+
+typedef struct Flag_Override {
+	char* dir;
+	size_t dirLen;
+	char* ext;
+	bool recurse;
+	char* file;
+	char* flags;
+} Flag_Override;
+
+typedef struct Flag_Set {
+	uint64_t mask;
+	char* flags;
+} Flag_Set;
+
+typedef struct Flag_Table {
+	char* baseFlags;
+	Flag_Override overrides[FLAGS_MAX_OVERRIDES];
+	size_t overrideCount;
+	Flag_Set* sets;
+	size_t setCount;
+	size_t setCapacity;
+} Flag_Table;
+
+// Separators are compared loosely, Windows paths can mix both
+static bool _PathStartsWith(char* path, char* prefix, size_t prefixLen)
+{
+	for (size_t i = 0; i < prefixLen; i += 1) {
+		if (path[i] == prefix[i])
+			continue;
+		if (!_IsPathSeparator(path[i]) || !_IsPathSeparator(prefix[i]))
+			return false;
+	}
+
+	return true;
+}
+
+static bool _AddFlagOverride(Arena* arena, Flag_Table* table, char* pattern, char* flags)
+{
+	if (table->overrideCount >= FLAGS_MAX_OVERRIDES) {
+		fprintf(stderr, "Too many flag sections, at most %d are supported\n", FLAGS_MAX_OVERRIDES);
+		return false;
+	}
+
+	Flag_Override* override = &table->overrides[table->overrideCount];
+	MemZero(override, sizeof(Flag_Override));
+	override->flags = flags;
+
+	char* file = GetFilenameFromPath(pattern);
+	if (file[0] == '*') {
+		char* dir = GetDirFromPath(arena, pattern);
+		override->dir = GetFullPath(arena, dir[0] != '\0' ? dir : ".");
+		override->dirLen = (override->dir != NULL) ? StrLen(override->dir) : 0;
+		override->ext = GetFileExtension(file);
+		override->recurse = MemCmp(file, "**", 2);
+	} else {
+		override->file = GetFullPath(arena, pattern);
+	}
+
+	if (override->dir == NULL && override->file == NULL)
+		fprintf(stderr, "Warning: flags for '%s' don't match any file\n", pattern);
+
+	table->overrideCount += 1;
+
+	return true;
+}
+
+// Sections named '<secPrefix><pattern>' apply everywhere, '<osSecPrefix><pattern>' only on this OS
+bool LoadFlagTable(Arena* arena, ini_t* ini, char* baseFlags, const char* secPrefix, const char* osSecPrefix, const char* propName, Flag_Table* table)
+{
+	MemZero(table, sizeof(Flag_Table));
+	table->baseFlags = baseFlags;
+
+	size_t secPrefixLen = StrLen(secPrefix);
+	size_t osSecPrefixLen = StrLen(osSecPrefix);
+	int secCount = ini_section_count(ini);
+	for (int sec = 0; sec < secCount; sec += 1) {
+		char* secName = (char*) ini_section_name(ini, sec);
+		char* pattern = NULL;
+		if (strncmp(secName, secPrefix, secPrefixLen) == 0)
+			pattern = &secName[secPrefixLen];
+		else if (strncmp(secName, osSecPrefix, osSecPrefixLen) == 0)
+			pattern = &secName[osSecPrefixLen];
+		else
+			continue;
+
+		int prop = ini_find_property(ini, sec, propName, 0);
+		if (prop == INI_NOT_FOUND)
+			continue;
+
+		char* flags = (char*) ini_property_value(ini, sec, prop);
+		if (!_AddFlagOverride(arena, table, pattern, flags))
+			return false;
+	}
+
+	return true;
+}
+
+static bool _MatchFlagOverride(Flag_Override* override, char* source)
+{
+	if (override->file != NULL)
+		return StrLen(source) == StrLen(override->file) && _PathStartsWith(source, override->file, StrLen(override->file));
+
+	if (override->dir == NULL || !_PathStartsWith(source, override->dir, override->dirLen) || !_IsPathSeparator(source[override->dirLen]))
+		return false;
+
+	char* rest = &source[override->dirLen + 1];
+	if (!override->recurse && (strchr(rest, '/') != NULL || strchr(rest, '\\') != NULL))
+		return false;
+
+	char* ext = GetFileExtension(GetFilenameFromPath(rest));
+	return override->ext == NULL || (ext != NULL && StrCmp(ext, override->ext));
+}
+
+// The flags for 'source', the base ones followed by every matching override in the order of the build file
+char* GetSourceFlags(Arena* arena, Flag_Table* table, char* source)
+{
+	if (table->overrideCount == 0)
+		return table->baseFlags;
+
+	char* absSource = source;
+	if (!_IsAbsolutePath(source))
+		absSource = GetFullPath(arena, source);
+	if (absSource == NULL)
+		return table->baseFlags;
+
+	uint64_t mask = 0;
+	for (size_t i = 0; i < table->overrideCount; i += 1) {
+		if (_MatchFlagOverride(&table->overrides[i], absSource))
+			mask |= 1ull << i;
+	}
+
+	if (mask == 0)
+		return table->baseFlags;
+
+	for (size_t i = 0; i < table->setCount; i += 1) {
+		if (table->sets[i].mask == mask)
+			return table->sets[i].flags;
+	}
+
+	size_t flagsLen = StrLen(table->baseFlags);
+	for (size_t i = 0; i < table->overrideCount; i += 1) {
+		if (mask & (1ull << i))
+			flagsLen += 1 + StrLen(table->overrides[i].flags);
+	}
+
+	char* flags = (char*) ArenaAlloc(arena, flagsLen + 1);
+	size_t offset = StrLen(table->baseFlags);
+	MemCpy(flags, table->baseFlags, offset);
+	for (size_t i = 0; i < table->overrideCount; i += 1) {
+		if (!(mask & (1ull << i)))
+			continue;
+
+		size_t len = StrLen(table->overrides[i].flags);
+		flags[offset] = ' ';
+		MemCpy(&flags[offset + 1], table->overrides[i].flags, len);
+		offset += 1 + len;
+	}
+	flags[offset] = '\0';
+
+	if (table->setCount >= table->setCapacity) {
+		size_t capacity = table->setCapacity > 0 ? table->setCapacity * 2 : 8;
+		Flag_Set* sets = (Flag_Set*) ArenaAlloc(arena, sizeof(Flag_Set) * capacity);
+		if (table->setCount > 0)
+			MemCpy(sets, table->sets, sizeof(Flag_Set) * table->setCount);
+
+		table->sets = sets;
+		table->setCapacity = capacity;
+	}
+
+	table->sets[table->setCount].mask = mask;
+	table->sets[table->setCount].flags = flags;
+	table->setCount += 1;
+
+	return flags;
+}
@@ -3,6 +3,9 @@
 	#define _CRT_NONSTDC_NO_DEPRECATE
 	#undef _CRT_SECURE_NO_WARNINGS
 	#define _CRT_SECURE_NO_WARNINGS
+#else
+	// Before the first include, 'OS_Linux.c' needs the CPU affinity API and friends
+	#define _GNU_SOURCE
 #endif
 
 #include <stddef.h>
@@ -12,24 +15,112 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
+
+#include "Arena.c"
 
+// Everything the INI parser allocates goes into the build arena, a NULL context falls back to the heap
+#define INI_MALLOC(ctx, size) ((ctx) != NULL ? ArenaAlloc((Arena*) (ctx), size) : malloc(size))
+#define INI_FREE(ctx, ptr) ((ctx) != NULL ? (void) 0 : free(ptr))
 #define INI_IMPLEMENTATION
 #include "ini.h"
 
+// Packed string table: every string lives back to back in one buffer, NUL terminated so
+// 'GetStrList()' can be handed out as a C string or an argv entry without copying
 typedef struct Str_List {
-	char** data;
+	char* buffer;
+	size_t* offsets;
+	size_t* lengths;
 	size_t size;
+	size_t capacity;
+	size_t bufferSize;
+	size_t bufferCapacity;
 } Str_List;
 
+void PushStrList(Arena* arena, Str_List* list, const char* str, size_t len);
+char* JoinStrList(Arena* arena, Str_List* list, const char* prefix, bool quote);
+size_t JoinedLenStrList(Str_List* list, size_t prefixLen, bool quote);
+Str_List SplitStringList(Arena* arena, char* strList);
+#define GetStrList(list, index) (&(list)->buffer[(list)->offsets[index]])
+#define FullLenStrList(list) ((list)->bufferSize - (list)->size)
+
+typedef struct Mapped_File {
+	char* data;
+	size_t size;
+	bool mapped;
+} Mapped_File;
+
 bool IsFileValid(char* path);
 bool IsDirValid(char* dir);
-size_t IterateDir(size_t startIndex, bool recurse, char** fileList, char* path, char* ext);
-char* GetLibsStr(Str_List libs);
+bool GetFileModTime(char* path, uint64_t* mtimeNs);
+
+// Changes whenever the file is replaced or rewritten, without reading it
+typedef struct File_Identity {
+	uint64_t id;
+	uint64_t mtimeNs;
+	uint64_t size;
+} File_Identity;
+
+bool GetFileIdentity(char* path, File_Identity* identity);
+bool CreateDirRecursive(char* path);
+bool MapFile(char* path, Mapped_File* file);
+void UnmapFile(Mapped_File* file);
+size_t IterateDir(Arena* arena, bool recurse, Str_List* fileList, char* path, char* ext);
+char* GetFullPath(Arena* arena, char* path);
+char* GetExecutablePath(Arena* arena);
+
+typedef struct Process_Stats {
+	uint64_t userTimeUs;
+	uint64_t sysTimeUs;
+	uint64_t maxRssKb;
+	uint64_t ioReadKb;
+	uint64_t ioWriteKb;
+	int exitCode;
+	// Killed for going past its memory limit, worth another try once nothing else competes for memory
+	bool oomKilled;
+} Process_Stats;
+
+typedef struct Job {
+	char* name;
+	char* cmd;
+	char* workDir;
+	// Relative to 'workDir'
+	char* output;
+	// Written by the same command next to 'output', like split DWARF, NULL when there's none
+	char* sideOutput;
+	// Relative to 'workDir' or absolute, NULL when the compiler doesn't write one
+	char* depFile;
+	// The compiler and its flags without the mode ones, set when the job can run on a worker
+	char* remoteArgs;
+	const char* category;
+	// Hash of everything that ends up in the output besides the input files, what the rebuild state records
+	uint64_t hash;
+	// Hash of the bytes a compile wrote, or of what a link read, 0 when unknown
+	uint64_t contentHash;
+	size_t slot;
+	uint64_t startUs;
+	uint64_t endUs;
+	Process_Stats stats;
+} Job;
 
 typedef struct Process_Data Process_Data;
-bool SpawnAsyncProcess(char* cmd, char* workDir, Process_Data* process);
+typedef struct Job_Placement Job_Placement;
+// The slot of a job that runs on its own, it may use every allowed CPU and has no memory limit
+#define PLACEMENT_ALONE SIZE_MAX
+char* ResolveProgramPath(char* program);
+bool CreateJobPlacement(char* affinity, char* priority, size_t reservedCores, bool isolate, uint64_t memoryMax, size_t slotCount, Job_Placement** placement, size_t* cpuCount);
+void DestroyJobPlacement(Job_Placement* placement);
+bool SpawnAsyncProcess(char* cmd, char* workDir, char* outputPath, Job_Placement* placement, size_t slot, Process_Data* process);
 bool WaitForMultipleProcesses(Process_Data* processList, size_t processCount);
+size_t WaitForAnyProcess(Process_Data* processList, size_t processCount, Process_Stats* stats);
+void GetSelfStats(Process_Stats* stats);
+uint64_t GetTimeUs();
 size_t GetThreadCount();
+uint64_t GetSystemTimeNs();
+char* GetLtoFlags(Arena* arena, char* compiler, char* linkFlags, char* ltoJobs, size_t freeSlots, char* ltoPartition, char* ltoCache);
+char* GetLinkerFlags(Arena* arena, char* compiler, char* linker, char* linkFlags, size_t threads, bool incremental, char** program);
+bool GetCacheDirStats(char* path, uint64_t since, size_t* entries, size_t* touched);
+char* CaptureProcessOutput(char* cmd, size_t* size);
 
 #if !defined(_WIN32)
 	// HACK: There are a ton of Str macros defined in 'shlwapi.h'
@@ -51,48 +142,178 @@ size_t GetThreadCount();
 
 #define CBUILDER_VERSION "0.0.1"
 
+#include "Trace.c"
+#include "Stats.c"
+#include "Rebuild.c"
+#include "CompDb.c"
+#include "Flags.c"
+#include "Toolchain.c"
+#include "Remote.c"
+
 #define SEC_MAIN "Program"
+#define SEC_FLAGS "Flags:"
+#define SEC_VARIANT "Variant.%s"
 #if defined(__linux__)
 	#define SEC_OS "Program.Linux"
+	#define SEC_OS_FLAGS "Flags.Linux:"
+	#define SEC_OS_VARIANT "Variant.%s.Linux"
 	#include <alloca.h>
 	#define ALLOCA(size) alloca(size)
+	#define MAX_RUNNING_JOBS SIZE_MAX
 #elif defined(_WIN32)
 	#define SEC_OS "Program.Win32"
+	#define SEC_OS_FLAGS "Flags.Win32:"
+	#define SEC_OS_VARIANT "Variant.%s.Win32"
 	#define ALLOCA(size) _alloca(size)
+	// 'WaitForAnyProcess()' waits on every running job with a single 'WaitForMultipleObjects()'
+	#define MAX_RUNNING_JOBS MAXIMUM_WAIT_OBJECTS
 #endif
 #define PROP_MAIN_SRCS "sources "
 #define PROP_MAIN_OUT "output "
+#define PROP_MAIN_TYPE "type "
+#define PROP_MAIN_WORKERS "workers "
+#define PROP_MAIN_LOOKAHEAD "workerLookahead "
 #define PROP_OS_COMP "compiler "
 #define PROP_OS_SYSLIBS "sysLibs "
 #define PROP_OS_CFLAGS "compFlags "
 #define PROP_OS_LFLAGS "linkFlags "
+#define PROP_OS_LTO_JOBS "ltoJobs "
+#define PROP_OS_LTO_PART "ltoPartition "
+#define PROP_OS_LTO_CACHE "ltoCache "
+#define PROP_OS_LINKER "linker "
+#define PROP_OS_INCREMENTAL "incrementalLink "
+#define PROP_OS_DEBUG_INFO "debugInfo "
+#define PROP_OS_DEBUG_PACKAGE "debugPackage "
+#define PROP_OS_THIN_ARCHIVE "thinArchive "
+#define PROP_OS_RAM_DIR "ramObjectDir "
+#define PROP_OS_RAM_STATE "ramWriteBackState "
+#define PROP_OS_JOB_AFFINITY "jobAffinity "
+#define PROP_OS_JOB_PRIORITY "jobPriority "
+#define PROP_OS_RESERVED_CORES "reservedCores "
+#define PROP_OS_JOB_MEMORY "jobMemoryMax "
 
 #if defined(__linux__)
-	#define COMP_FLAGS "-c"
+	#define COMP_FLAGS "-c -MMD"
 	#define COMP_OUT "-o "
 	#define COMP_EXE_EXT ""
 	#define COMP_DLL_EXT ".so"
-	#define COMP_OBJ_SEARCH "%s/*.o"
+	#define COMP_OBJ_OUT "-o "
+	#define COMP_OBJ_EXT ".o"
+	#define COMP_DEP_EXT ".d"
+	#define COMP_DEP_OUT "-MF "
+	#define COMP_DEP_STDOUT false
+	#define COMP_LIB_PREFIX "-l"
+	// A single argument can't be longer than 'MAX_ARG_STRLEN', the whole command shares 'ARG_MAX' with the environment
+	#define COMP_RSP_THRESHOLD (128 * 1024)
+	#define COMP_RSP_ESCAPES "\\\""
+	// Version, target, search dirs and every builtin define
+	#define COMP_PROBE "\"%s\"%s -v -dM -E -x c - < /dev/null 2>&1"
 	// That's hacky but it works
 	#define COMP_LINK compiler
+	#define COMP_DEBUG_FULL "-g"
+	#define COMP_DEBUG_SPLIT "-g -gsplit-dwarf"
+	#define COMP_DEBUG_COMPRESSED "-g -gz"
+	#define COMP_DEBUG_LINK NULL
+	// The linker compresses what it copies into the output as well
+	#define COMP_DEBUG_LINK_COMPRESSED "-gz"
+	#define COMP_DWO_EXT ".dwo"
+	#define COMP_DWP "dwp"
+	#define COMP_LIB_EXT ".a"
+	#define COMP_AR "ar"
+	#define COMP_AR_FLAGS "rcs"
+	// Members are only referenced by path, the objects stay where they are
+	#define COMP_AR_THIN_FLAGS "rcsT"
+	#define COMP_AR_OUT ""
+	// 'ar r' replaces the members it's given and keeps the others
+	#define COMP_AR_SELF false
 #elif defined(_WIN32)
-	#define COMP_FLAGS "/c"
+	#define COMP_FLAGS "/c /showIncludes"
 	#define COMP_OUT "/OUT:"
 	#define COMP_EXE_EXT ".exe"
 	#define COMP_DLL_EXT ".dll"
-	#define COMP_OBJ_SEARCH "%s/*.obj"
+	#define COMP_OBJ_OUT "/Fo"
+	#define COMP_OBJ_EXT ".obj"
+	// '/showIncludes' prints the headers to stdout, that's captured into the dependency file and rewritten
+	// by 'ConvertShowIncludes()' once the compile is done
+	#define COMP_DEP_EXT ".d"
+	#define COMP_DEP_OUT NULL
+	#define COMP_DEP_STDOUT true
+	#define COMP_LIB_PREFIX ""
+	// 'CreateProcess' takes at most 32767 characters, the rest is left for the flags
+	#define COMP_RSP_THRESHOLD (24 * 1024)
+	#define COMP_RSP_ESCAPES ""
+	// Without arguments it only prints its version and target
+	#define COMP_PROBE "\"%s\"%s 2>&1"
 	#define COMP_LINK "link.exe"
+	// The debug info already goes to a separate PDB, there's nothing to split or compress
+	#define COMP_DEBUG_FULL "/Zi"
+	#define COMP_DEBUG_SPLIT NULL
+	#define COMP_DEBUG_COMPRESSED NULL
+	#define COMP_DEBUG_LINK "/DEBUG"
+	#define COMP_DEBUG_LINK_COMPRESSED "/DEBUG"
+	#define COMP_DWO_EXT NULL
+	#define COMP_DWP NULL
+	#define COMP_LIB_EXT ".lib"
+	#define COMP_AR "lib.exe"
+	#define COMP_AR_FLAGS "/NOLOGO"
+	#define COMP_AR_THIN_FLAGS NULL
+	#define COMP_AR_OUT "/OUT:"
+	// 'lib.exe' only keeps the members of the libraries it's given, so the old one is an input of the update
+	#define COMP_AR_SELF true
 #endif
 
 #define CHECK_INI(sec) (sec != INI_NOT_FOUND)
 char* GetIniProp(ini_t* ini, int sec, const char* name);
+char* GetIniPropOpt(ini_t* ini, int sec, const char* name, char* defaultValue);
 char* GetFilenameFromPath(char* path);
-char* GetDirFromPath(char* path);
+char* GetDirFromPath(Arena* arena, char* path);
 char* GetFileExtension(char* file);
-Str_List SplitStringList(char* strList);
-Str_List ParseFileList(char* sources);
-size_t FullLenStrList(Str_List list);
-void DestroyStrList(Str_List* list);
+size_t ParseFileList(Arena* arena, Str_List* fileList, char* sources);
+bool WriteResponseFile(char* path, Str_List* files, Str_List* libs);
+bool ParseByteSize(char* value, uint64_t* size);
+
+// One configuration of the program, the sources are shared but every variant has its own objects and state
+typedef struct Build_Variant {
+	char* name;
+	char* outputDir;
+	// Where the compiles and the link run and the intermediate files live, the output dir unless they're kept in RAM
+	char* objectDir;
+	// Absolute, set when the dependency files are kept apart from the objects
+	char* depDir;
+	// The output as the link sees it from 'objectDir'
+	char* outputArg;
+	// Up to date units whose objects are gone from the RAM dir
+	size_t evictedCount;
+	char* compFlags;
+	char* linkFlags;
+	Flag_Table flagTable;
+	char* statePath;
+	Build_State state;
+	// The units, plus room for the link
+	Job* jobs;
+	Dirty_Check* checks;
+	size_t dirtyCount;
+	// In unit order, so the link command doesn't depend on which units were rebuilt
+	Str_List objFiles;
+	char* outputPath;
+	bool linkRuns;
+	// With split DWARF: every unit's '.dwo', and the job packaging them into one '.dwp' next to the output
+	bool splitDebug;
+	Str_List dwoFiles;
+	Job packageJob;
+	bool packageRuns;
+	char* ltoFlags;
+	char* linkerFlags;
+	char* ltoCachePath;
+	size_t ltoCacheEntries;
+	size_t ltoCacheTouched;
+} Build_Variant;
+
+bool LoadVariant(Arena* arena, ini_t* ini, char* name, char* outputDir, char* compFlags, char* linkFlags, char* debugInfo, Build_Variant* variant);
+bool SetRamObjectDir(Arena* arena, char* ramDir, bool keepState, Build_Variant* variant);
+char* FormatArchiveCmd(Arena* arena, char* workDir, char* archivePath, Str_List* members, bool thin, bool update);
+bool HasSameNamedMembers(Arena* arena, Str_List* members);
+bool RunJobs(Job** jobs, size_t jobCount, size_t slotCount, Remote_Pool* remote, Job_Placement* placement, Trace* trace);
 
 int main(int argc, char* argv[])
 {
@@ -101,6 +322,14 @@ int main(int argc, char* argv[])
 		"	Options:\n"
 		"		--version: Show version\n"
 		"		--help: Show this message\n"
+		"		--trace <file.json>: Write a Chrome Trace Event profile of the build\n"
+		"		--summary: Print build statistics at the end\n"
+		"		--summary-json <file.json>: Write build statistics as JSON\n"
+		"		--compdb: Write compile_commands.json next to the build file, without compiling\n"
+		"		--dry-run: Print the commands of the jobs that are out of date, without running them\n"
+		"		--explain: Print why each job is out of date, without running them\n"
+		"		--variants <a,b>: Build the '[Variant.a]' and '[Variant.b]' configurations together\n"
+		"		--workers <host[:port][/jobs],...>: Compile on these 'CBuilderWorker' daemons, overrides 'workers'\n"
 	;
 
 	if (argc < 2) {
@@ -109,136 +338,934 @@ int main(int argc, char* argv[])
 		return -1;
 	}
 
-	char* arg = argv[1];
-	if (StrCmp(arg, "--version")) {
-		printf("CBuilder version %s\n", CBUILDER_VERSION);
-		return 0;
-	} else if (StrCmp(arg, "--help")) {
-		printf("Usage:\n");
-		printf("%s", cmdUsage);
-		return 0;
-	} else {
-		if (!IsFileValid(arg)) {
-			fprintf(stderr, "Invalid path!\n");
+#if defined(__linux__)
+	// A remote job, started by 'RunJobs()' and not by hand
+	if (StrCmp(argv[1], "--dispatch"))
+		return RunDispatch(argc - 2, &argv[2]);
+#endif
+
+	char* buildFile = NULL;
+	char* tracePath = NULL;
+	char* summaryPath = NULL;
+	bool printSummary = false;
+	bool writeCompDb = false;
+	bool dryRun = false;
+	bool explain = false;
+	char* variantNames = NULL;
+	char* workerList = NULL;
+	for (int i = 1; i < argc; i += 1) {
+		char* arg = argv[i];
+		if (StrCmp(arg, "--version")) {
+			printf("CBuilder version %s\n", CBUILDER_VERSION);
+			return 0;
+		} else if (StrCmp(arg, "--help")) {
+			printf("Usage:\n");
+			printf("%s", cmdUsage);
+			return 0;
+		} else if (StrCmp(arg, "--trace") && i + 1 < argc) {
+			i += 1;
+			tracePath = argv[i];
+		} else if (StrCmp(arg, "--summary")) {
+			printSummary = true;
+		} else if (StrCmp(arg, "--summary-json") && i + 1 < argc) {
+			i += 1;
+			summaryPath = argv[i];
+		} else if (StrCmp(arg, "--compdb")) {
+			writeCompDb = true;
+		} else if (StrCmp(arg, "--dry-run")) {
+			dryRun = true;
+		} else if (StrCmp(arg, "--explain")) {
+			explain = true;
+		} else if (StrCmp(arg, "--variants") && i + 1 < argc) {
+			i += 1;
+			variantNames = argv[i];
+		} else if (StrCmp(arg, "--workers") && i + 1 < argc) {
+			i += 1;
+			workerList = argv[i];
+		} else if (arg[0] == '-' && arg[1] == '-') {
+			fprintf(stderr, "Invalid option '%s'! Usage:\n", arg);
+			fprintf(stderr, "%s\n", cmdUsage);
 			return -1;
+		} else {
+			buildFile = arg;
 		}
+	}
+
+	if (buildFile == NULL || !IsFileValid(buildFile)) {
+		fprintf(stderr, "Invalid path!\n");
+		return -1;
+	}
+
+	size_t thrdCount = GetThreadCount();
+	Trace trace = CreateTrace(tracePath != NULL, thrdCount);
+	Trace_Phase buildPhase = TraceBeginPhase(&trace, "Build");
+
+	Trace_Phase parsePhase = TraceBeginPhase(&trace, "Parse build file");
+	// The config points straight into the mapped file, so it has to stay mapped until the end
+	Mapped_File buildData = {0};
+	if (!MapFile(buildFile, &buildData)) {
+		fprintf(stderr, "Error trying to read '%s'\n", buildFile);
+		return -1;
+	}
+
+	// Strings and lists that live for the whole build are never freed one by one, the arena drops them all at the end
+	Arena arena = {0};
+	ini_t* config = ini_load_inplace(buildData.data, &arena);
+
+	int mainSec = ini_find_section(config, SEC_MAIN, 0);
+	int osSec = ini_find_section(config, SEC_OS, 0);
+	if (!CHECK_INI(mainSec) || !CHECK_INI(osSec)) {
+		fprintf(stderr, "Invalid build config!\n");
+		return -1;
+	}
+
+	char* sources 	= GetIniProp(config, mainSec, PROP_MAIN_SRCS);
+	char* output 	= GetIniProp(config, mainSec, PROP_MAIN_OUT);
+	char* type 		= GetIniPropOpt(config, mainSec, PROP_MAIN_TYPE, "executable");
+	char* workers 	= workerList != NULL ? workerList : GetIniPropOpt(config, mainSec, PROP_MAIN_WORKERS, NULL);
+	char* lookahead = GetIniPropOpt(config, mainSec, PROP_MAIN_LOOKAHEAD, NULL);
+	char* compiler 	= GetIniProp(config, osSec, PROP_OS_COMP);
+	char* sysLibs 	= GetIniProp(config, osSec, PROP_OS_SYSLIBS);
+	char* compFlags = GetIniProp(config, osSec, PROP_OS_CFLAGS);
+	char* linkFlags = GetIniProp(config, osSec, PROP_OS_LFLAGS);
+	char* ltoJobs 	= GetIniPropOpt(config, osSec, PROP_OS_LTO_JOBS, "auto");
+	char* ltoPart 	= GetIniPropOpt(config, osSec, PROP_OS_LTO_PART, NULL);
+	char* ltoCache 	= GetIniPropOpt(config, osSec, PROP_OS_LTO_CACHE, NULL);
+	char* linker 	= GetIniPropOpt(config, osSec, PROP_OS_LINKER, "default");
+	bool incrementalLink = StrCmp(GetIniPropOpt(config, osSec, PROP_OS_INCREMENTAL, "false"), "true");
+	char* debugInfo = GetIniPropOpt(config, osSec, PROP_OS_DEBUG_INFO, NULL);
+	bool debugPackage = StrCmp(GetIniPropOpt(config, osSec, PROP_OS_DEBUG_PACKAGE, "false"), "true");
+	bool thinArchive = StrCmp(GetIniPropOpt(config, osSec, PROP_OS_THIN_ARCHIVE, "false"), "true");
+	char* ramDir 	= GetIniPropOpt(config, osSec, PROP_OS_RAM_DIR, NULL);
+	bool ramKeepState = StrCmp(GetIniPropOpt(config, osSec, PROP_OS_RAM_STATE, "false"), "true");
+	char* jobAffinity = GetIniPropOpt(config, osSec, PROP_OS_JOB_AFFINITY, "none");
+	char* jobPriority = GetIniPropOpt(config, osSec, PROP_OS_JOB_PRIORITY, "normal");
+	char* reservedCoresStr = GetIniPropOpt(config, osSec, PROP_OS_RESERVED_CORES, "0");
+	char* jobMemory = GetIniPropOpt(config, osSec, PROP_OS_JOB_MEMORY, NULL);
+
+	bool staticLib = StrCmp(type, "staticLib");
+	if (!staticLib && !StrCmp(type, "executable")) {
+		fprintf(stderr, "Invalid 'type = %s', expected 'executable' or 'staticLib'\n", type);
+		return -1;
+	}
+	if (thinArchive && COMP_AR_THIN_FLAGS == NULL) {
+		fprintf(stderr, "Warning: thin archives aren't supported on this platform, writing a full one\n");
+		thinArchive = false;
+	}
+	if (thinArchive && ramDir != NULL) {
+		fprintf(stderr, "Warning: a thin archive would point into '%s', writing a full one\n", ramDir);
+		thinArchive = false;
+	}
+	const char* outputExt = staticLib ? COMP_LIB_EXT : COMP_EXE_EXT;
+
+	// At least one of the online cores has to be left for the build
+	char* reservedEnd = NULL;
+	errno = 0;
+	size_t onlineCores = GetThreadCount();
+	size_t reservedCores = (size_t) strtoull(reservedCoresStr, &reservedEnd, 10);
+	if (reservedCoresStr[0] < '0' || reservedCoresStr[0] > '9' || *reservedEnd != '\0' || errno == ERANGE || reservedCores >= onlineCores) {
+		fprintf(stderr, "Invalid 'reservedCores = %s', expected a count below the %zu online cores\n", reservedCoresStr, onlineCores);
+		return -1;
+	}
 
-		FILE* file = fopen(arg, "r");
+	// 'max' only accounts every job on its own, a size also caps each compile at it
+	uint64_t memoryMax = 0;
+	if (jobMemory != NULL && !StrCmp(jobMemory, "max") && !ParseByteSize(jobMemory, &memoryMax)) {
+		fprintf(stderr, "Invalid 'jobMemoryMax = %s', expected 'max' or a size like '2G'\n", jobMemory);
+		return -1;
+	}
 
-		fseek(file, 0, SEEK_END);
-		size_t fileSize = ftell(file);
-		fseek(file, 0, SEEK_SET);
+	// Compiles are pinned slot by slot, links use several threads so they get every CPU the build may use
+	// and aren't capped, one link needs far more memory than a compile
+	Job_Placement* compilePlacement = NULL;
+	Job_Placement* linkPlacement = NULL;
+	size_t cpuCount = thrdCount;
+	if (!CreateJobPlacement(jobAffinity, jobPriority, reservedCores, jobMemory != NULL, memoryMax, thrdCount, &compilePlacement, &cpuCount) ||
+		!CreateJobPlacement("none", jobPriority, reservedCores, jobMemory != NULL, 0, thrdCount, &linkPlacement, &cpuCount)) {
+		fprintf(stderr, "Error trying to place the jobs\n");
+		return -1;
+	}
+	if (cpuCount < thrdCount) {
+		thrdCount = cpuCount;
+		trace.laneCount = thrdCount;
+	}
 
-		char* fileData = (char*) malloc(fileSize + 1);
-		MemZero(fileData, fileSize + 1);
-		fread(fileData, 1, fileSize, file);
+	// Resolving the compiler up front fails early and makes every spawn after it a cache hit
+	size_t compilerNameLen = strcspn(compiler, " ");
+	char* compilerName = (char*) ALLOCA(compilerNameLen + 1);
+	MemCpy(compilerName, compiler, compilerNameLen);
+	compilerName[compilerNameLen] = '\0';
+	char* compilerPath = ResolveProgramPath(compilerName);
+	if (compilerPath == NULL) {
+		fprintf(stderr, "Compiler '%s' not found!\n", compilerName);
+		return -1;
+	}
 
-		ini_t* config = ini_load(fileData, NULL);
+	char* outputDir  = GetDirFromPath(&arena, output);
+	char* outputFile = GetFilenameFromPath(output);
+
+	Str_List sourcesSplitted = SplitStringList(&arena, sources);
+	Str_List sysLibsSplitted = SplitStringList(&arena, sysLibs);
+
+	// Without '--variants' there is a single unnamed one, building right into the output dir
+	size_t variantCount = 1;
+	Build_Variant* variants = NULL;
+	if (variantNames != NULL) {
+		Str_List variantList = SplitStringList(&arena, variantNames);
+		variantCount = variantList.size;
+		variants = (Build_Variant*) ArenaAlloc(&arena, sizeof(Build_Variant) * variantCount);
+		for (size_t v = 0; v < variantCount; v += 1) {
+			if (!LoadVariant(&arena, config, GetStrList(&variantList, v), outputDir, compFlags, linkFlags, debugInfo, &variants[v]))
+				return -1;
+		}
+	} else {
+		variants = (Build_Variant*) ArenaAlloc(&arena, sizeof(Build_Variant));
+		if (!LoadVariant(&arena, config, NULL, outputDir, compFlags, linkFlags, debugInfo, &variants[0]))
+			return -1;
+	}
 
-		int mainSec = ini_find_section(config, SEC_MAIN, 0);
-		int osSec = ini_find_section(config, SEC_OS, 0);
-		if (!CHECK_INI(mainSec) || !CHECK_INI(osSec)) {
-			fprintf(stderr, "Invalid build config!\n");
+	for (size_t v = 0; v < variantCount && ramDir != NULL; v += 1) {
+		if (!SetRamObjectDir(&arena, ramDir, ramKeepState, &variants[v])) {
+			fprintf(stderr, "Error trying to create the object dir of '%s' in '%s'\n", variants[v].outputDir, ramDir);
 			return -1;
 		}
+	}
 
-		char* sources 	= GetIniProp(config, mainSec, PROP_MAIN_SRCS);
-		char* output 	= GetIniProp(config, mainSec, PROP_MAIN_OUT);
-		char* compiler 	= GetIniProp(config, osSec, PROP_OS_COMP);
-		char* sysLibs 	= GetIniProp(config, osSec, PROP_OS_SYSLIBS);
-		char* compFlags = GetIniProp(config, osSec, PROP_OS_CFLAGS);
-		char* linkFlags = GetIniProp(config, osSec, PROP_OS_LFLAGS);
+	Remote_Pool remote = {0};
+	if (!LoadRemotePool(&arena, workers, lookahead, &remote))
+		return -1;
+	TraceEndPhase(&trace, &parsePhase);
+
+	Trace_Phase expandPhase = TraceBeginPhase(&trace, "Expand sources");
+	Str_List sourceFiles = {0};
+	for (size_t i = 0; i < sourcesSplitted.size; i += 1)
+		ParseFileList(&arena, &sourceFiles, GetStrList(&sourcesSplitted, i));
+	size_t jobCount = sourceFiles.size;
+	TraceEndPhase(&trace, &expandPhase);
+
+	size_t totalDirty = 0;
+	uint64_t toolchainHash = 0;
+	Trace_Phase compilePhase = TraceBeginPhase(&trace, "Compile");
+	{
+		char* rootDir = GetFullPath(&arena, ".");
+		for (size_t v = 0; v < variantCount; v += 1) {
+			Build_Variant* variant = &variants[v];
+			variant->jobs = (Job*) ArenaAlloc(&arena, sizeof(Job) * (jobCount + 1));
+			MemZero(variant->jobs, sizeof(Job) * (jobCount + 1));
+
+			for (size_t i = 0; i < jobCount; i += 1) {
+				char* source = GetStrList(&sourceFiles, i);
+				char* flags = GetSourceFlags(&arena, &variant->flagTable, source);
+				char* output = GetObjectPath(&arena, rootDir, source, COMP_OBJ_EXT);
+				PushStrList(&arena, &variant->objFiles, output, StrLen(output));
+
+				// Kept apart from the objects, the dependency file needs an explicit path
+				char* depFile = NULL;
+				char* depArg = "";
+				if (COMP_DEP_EXT != NULL) {
+					depFile = GetObjectPath(&arena, rootDir, source, COMP_DEP_EXT);
+					if (variant->depDir != NULL) {
+						size_t depFileLen = 1 + snprintf(NULL, 0, "%s/%s", variant->depDir, depFile);
+						char* fullDepFile = (char*) ArenaAlloc(&arena, depFileLen);
+						snprintf(fullDepFile, depFileLen, "%s/%s", variant->depDir, depFile);
+						depFile = fullDepFile;
+					}
+					if (variant->depDir != NULL && COMP_DEP_OUT != NULL) {
+						size_t depArgLen = 1 + snprintf(NULL, 0, "%s\"%s\" ", COMP_DEP_OUT, depFile);
+						depArg = (char*) ArenaAlloc(&arena, depArgLen);
+						snprintf(depArg, depArgLen, "%s\"%s\" ", COMP_DEP_OUT, depFile);
+					}
+				}
 
-		char* outputDir  = GetDirFromPath(output);
-		char* outputFile = GetFilenameFromPath(output);
+				const char* cmdFmt = "%s %s %s %s%s\"%s\" \"%s\"";
+				size_t cmdLen = 1 + snprintf(NULL, 0, cmdFmt, compiler, COMP_FLAGS, flags, depArg, COMP_OBJ_OUT, output, source);
+				char* cmd = (char*) ArenaAlloc(&arena, cmdLen);
+				snprintf(cmd, cmdLen, cmdFmt, compiler, COMP_FLAGS, flags, depArg, COMP_OBJ_OUT, output, source);
+
+				Job* job = &variant->jobs[i];
+				job->name = source;
+				job->cmd = cmd;
+				job->workDir = variant->objectDir;
+				job->depFile = depFile;
+				job->output = output;
+				job->category = "compile";
+
+				// The worker only sends the object back, so units with a side output are always compiled here,
+				// and so are the ones that aren't C or C++
+				if (variant->splitDebug) {
+					job->sideOutput = GetObjectPath(&arena, rootDir, source, COMP_DWO_EXT);
+					PushStrList(&arena, &variant->dwoFiles, job->sideOutput, StrLen(job->sideOutput));
+				} else if (remote.slotCount > 0 && GetRemoteUnitExt(source) != NULL) {
+					size_t remoteArgsLen = 1 + snprintf(NULL, 0, "%s %s", compiler, flags);
+					job->remoteArgs = (char*) ArenaAlloc(&arena, remoteArgsLen);
+					snprintf(job->remoteArgs, remoteArgsLen, "%s %s", compiler, flags);
+				}
+			}
+		}
 
-		Str_List sourcesSplitted = SplitStringList(sources);
-		Str_List sysLibsSplitted = SplitStringList(sysLibs);
+		// Tools only understand a single configuration, the first variant is the one they get
+		if (writeCompDb) {
+			char* compDbDir = variants[0].objectDir;
+			char* buildDir = GetDirFromPath(&arena, buildFile);
+			const char* pathFmt = (buildDir[0] != '\0') ? "%s/%s" : "%s%s";
+			size_t pathLen = 1 + snprintf(NULL, 0, pathFmt, buildDir, COMPDB_FILE_NAME);
+			char* compDbPath = (char*) ArenaAlloc(&arena, pathLen);
+			snprintf(compDbPath, pathLen, pathFmt, buildDir, COMPDB_FILE_NAME);
+
+			// Every command runs inside the output dir, which may not exist before the first build
+			char* directory = GetFullPath(&arena, compDbDir[0] != '\0' ? compDbDir : ".");
+			if (directory == NULL) {
+				char* workDir = GetFullPath(&arena, ".");
+				size_t dirLen = 1 + snprintf(NULL, 0, "%s/%s", workDir, compDbDir);
+				directory = (char*) ArenaAlloc(&arena, dirLen);
+				snprintf(directory, dirLen, "%s/%s", workDir, compDbDir);
+			}
 
-		size_t thrdCount = GetThreadCount();
+			size_t changed = 0;
+			if (!WriteCompileDb(&arena, variants[0].jobs, jobCount, directory, compDbPath, &changed)) {
+				fprintf(stderr, "Error trying to write compilation database '%s'\n", compDbPath);
+				return -1;
+			}
+			printf("Compilation database '%s': %zu entries, %zu changed\n", compDbPath, jobCount, changed);
 
-		for (size_t i = 0; i < sourcesSplitted.size; i += 1) {
-			Str_List sourceFiles = ParseFileList(sourcesSplitted.data[i]);
-			for (size_t j = 0; j < sourceFiles.size; j += thrdCount) {
-				Process_Data* processes = ALLOCA(sizeof(Process_Data) * thrdCount);
-				for (size_t k = 0; (k < thrdCount) && (k + j < sourceFiles.size); k += 1) {
-					size_t srcIdx = j + k;
+			DestroyArena(&arena);
+			UnmapFile(&buildData);
+			return 0;
+		}
 
-					const char* cmdFmt = "%s %s %s %s";
-					size_t cmdLen = 1 + snprintf(NULL, 0, cmdFmt, compiler, COMP_FLAGS, compFlags, sourceFiles.data[srcIdx]);
-					char* cmd = (char*) malloc(cmdLen);
-					snprintf(cmd, cmdLen, cmdFmt, compiler, COMP_FLAGS, compFlags, sourceFiles.data[srcIdx]);
+		// Every job hash starts from it, a different compiler makes every recorded job out of date.
+		// Probed only now, writing the compilation database doesn't need to run the compiler.
+		Trace_Phase probePhase = TraceBeginPhase(&trace, "Probe toolchain");
+		{
+			const char* pathFmt = (outputDir[0] != '\0') ? "%s/%s" : "%s%s";
+			size_t pathLen = 1 + snprintf(NULL, 0, pathFmt, outputDir, TOOLCHAIN_FILE_NAME);
+			char* toolchainPath = (char*) ArenaAlloc(&arena, pathLen);
+			snprintf(toolchainPath, pathLen, pathFmt, outputDir, TOOLCHAIN_FILE_NAME);
 
-					bool ok = SpawnAsyncProcess(cmd, outputDir, &processes[k]);
-					if (!ok) {
-						fprintf(stderr, "Error trying to compile file '%s'\n", sourceFiles.data[srcIdx]);
-						return -1;
+			if (!GetToolchainFingerprint(&arena, compilerPath, &compiler[compilerNameLen], COMP_PROBE, toolchainPath, &toolchainHash)) {
+				fprintf(stderr, "Error trying to identify the compiler '%s'\n", compilerPath);
+				return -1;
+			}
+		}
+		TraceEndPhase(&trace, &probePhase);
+
+		for (size_t v = 0; v < variantCount; v += 1) {
+			for (size_t i = 0; i < jobCount; i += 1) {
+				Job* job = &variants[v].jobs[i];
+				job->hash = HashStr(job->cmd, StrLen(job->cmd), toolchainHash);
+			}
+		}
+
+		// Only the units whose inputs changed since the last build get compiled
+		Trace_Phase checkPhase = TraceBeginPhase(&trace, "Check dependencies");
+		for (size_t v = 0; v < variantCount; v += 1) {
+			Build_Variant* variant = &variants[v];
+			variant->state = LoadBuildState(&arena, variant->statePath);
+			variant->checks = (Dirty_Check*) ArenaAlloc(&arena, sizeof(Dirty_Check) * (jobCount + 1));
+			const char* outputPathFmt = (variant->outputDir[0] != '\0') ? "%s/%s%s" : "%s%s%s";
+			size_t outputPathLen = 1 + snprintf(NULL, 0, outputPathFmt, variant->outputDir, outputFile, outputExt);
+			variant->outputPath = (char*) ArenaAlloc(&arena, outputPathLen);
+			snprintf(variant->outputPath, outputPathLen, outputPathFmt, variant->outputDir, outputFile, outputExt);
+
+			// Objects in RAM that are gone since the last link were part of the output, which still stands in for them
+			uint64_t evictedTime = 0;
+			if (variant->objectDir != variant->outputDir) {
+				GetFileModTime(variant->outputPath, &evictedTime);
+
+				char* fullOutputDir = GetFullPath(&arena, variant->outputDir[0] != '\0' ? variant->outputDir : ".");
+				size_t outputArgLen = 1 + snprintf(NULL, 0, "%s/%s%s", fullOutputDir, outputFile, outputExt);
+				variant->outputArg = (char*) ArenaAlloc(&arena, outputArgLen);
+				snprintf(variant->outputArg, outputArgLen, "%s/%s%s", fullOutputDir, outputFile, outputExt);
+			} else {
+				size_t outputArgLen = 1 + snprintf(NULL, 0, "%s%s", outputFile, outputExt);
+				variant->outputArg = (char*) ArenaAlloc(&arena, outputArgLen);
+				snprintf(variant->outputArg, outputArgLen, "%s%s", outputFile, outputExt);
+			}
+
+			for (size_t i = 0; i < jobCount; i += 1) {
+				Job* job = &variant->jobs[i];
+				variant->checks[i] = CheckJob(&arena, &variant->state, job, variant->objectDir, evictedTime);
+				if (variant->checks[i].reason != DIRTY_NONE)
+					variant->dirtyCount += 1;
+				else if (variant->checks[i].evicted)
+					variant->evictedCount += 1;
+			}
+
+			// The link reads every object, once it has to run the evicted ones come back along with the dirty ones
+			if (variant->dirtyCount > 0 && variant->evictedCount > 0) {
+				for (size_t i = 0; i < jobCount; i += 1) {
+					if (variant->checks[i].evicted) {
+						variant->checks[i].reason = DIRTY_OUTPUT_MISSING;
+						variant->checks[i].evicted = false;
 					}
+				}
+				variant->dirtyCount += variant->evictedCount;
+				variant->evictedCount = 0;
+			}
 
-					free(cmd);
+			totalDirty += variant->dirtyCount;
+		}
+		TraceEndPhase(&trace, &checkPhase);
+
+		if (dryRun || explain) {
+			for (size_t v = 0; v < variantCount; v += 1) {
+				Build_Variant* variant = &variants[v];
+				if (variant->name != NULL)
+					printf("Variant '%s':\n", variant->name);
+
+				for (size_t i = 0; i < jobCount; i += 1) {
+					if (variant->checks[i].reason == DIRTY_NONE)
+						continue;
+
+					if (explain)
+						PrintDirtyReason(&variant->jobs[i], &variant->checks[i]);
+					if (dryRun)
+						printf("%s\n", variant->jobs[i].cmd);
 				}
 
-				// TODO: Maybe we should destroy process data as well
-				WaitForMultipleProcesses(processes, thrdCount);
-				//Sleep(1000 * 5); // HACK: Should be removed when 'WaitForMultipleProcesses()' got fixed
+				// The link command depends on the objects, it's only known once the compiles are done
+				uint64_t outputTime = 0;
+				bool outputMissing = !GetFileModTime(variant->outputPath, &outputTime);
+				if (variant->dirtyCount > 0 || outputMissing) {
+					if (explain && outputMissing)
+						printf("%s%s: output missing\n", outputFile, outputExt);
+					else if (explain)
+						printf("%s%s: %zu units out of date\n", outputFile, outputExt, variant->dirtyCount);
+					if (dryRun)
+						printf("link %s\n", variant->outputPath);
+				}
 			}
 
-			DestroyStrList(&sourceFiles);
+			printf("%zu of %zu units out of date\n", totalDirty, jobCount * variantCount);
+
+			DestroyArena(&arena);
+			UnmapFile(&buildData);
+			return 0;
 		}
 
-		// Linking stage
-		{
-			size_t objPathLen = 1 + snprintf(NULL, 0, COMP_OBJ_SEARCH, outputDir);
-			char* objPath = (char*) malloc(objPathLen);
-			snprintf(objPath, objPathLen, COMP_OBJ_SEARCH, outputDir);
+		// The dirty units of every variant share the same slots
+		Job** pool = (Job**) ArenaAlloc(&arena, sizeof(Job*) * (totalDirty + 1));
+		size_t poolSize = 0;
+		for (size_t v = 0; v < variantCount; v += 1) {
+			Build_Variant* variant = &variants[v];
+			PartitionDirtyJobs(&arena, variant->jobs, jobCount, variant->checks);
+			if (!CreateOutputDirs(variant->jobs, variant->dirtyCount, variant->objectDir) ||
+				(variant->depDir != NULL && !CreateOutputDirs(variant->jobs, variant->dirtyCount, variant->depDir))) {
+				fprintf(stderr, "Error trying to create the object dirs in '%s'\n", variant->objectDir);
+				return -1;
+			}
 
-			Str_List objFiles = ParseFileList(objPath);
+			for (size_t i = 0; i < variant->dirtyCount; i += 1) {
+				pool[poolSize] = &variant->jobs[i];
+				poolSize += 1;
+			}
+		}
 
-			char* objFilesStr = (char*) malloc(FullLenStrList(objFiles));
-			size_t objFilesStrOffset = 0;
-			for (size_t i = 0; i < objFiles.size; i += 1) {
-				size_t fileLen = StrLen(objFiles.data[i]);
-				MemCpy(&objFilesStr[objFilesStrOffset], objFiles.data[i], fileLen + 1);
-				if (i < objFiles.size - 1)
-					objFilesStr[objFilesStrOffset + fileLen] = ' ';
+		if (poolSize > 0 && remote.slotCount > 0) {
+			ProbeRemoteWorkers(&arena, &remote);
+			trace.laneCount += remote.slotCount;
+		}
+
+		bool ok = RunJobs(pool, poolSize, thrdCount, &remote, compilePlacement, &trace);
+		for (size_t i = 0; i < poolSize; i += 1) {
+			if (pool[i]->endUs != 0 && pool[i]->stats.exitCode == 0)
+				pool[i]->contentHash = HashJobOutput(pool[i]);
+		}
+		if (!ok) {
+			for (size_t v = 0; v < variantCount; v += 1)
+				WriteBuildState(variants[v].statePath, variants[v].jobs, jobCount + 1, &variants[v].state);
+			fprintf(stderr, "Error trying to compile '%s%s'\n", outputFile, outputExt);
+			return -1;
+		}
+	}
+	TraceEndPhase(&trace, &compilePhase);
+
+	// Linking stage
+	size_t linkCount = 0;
+	Trace_Phase linkPhase = TraceBeginPhase(&trace, "Link");
+	{
+		// A link and a debug info package per variant
+		Job** linkPool = (Job**) ArenaAlloc(&arena, sizeof(Job*) * variantCount * 2);
+		for (size_t v = 0; v < variantCount; v += 1) {
+			Build_Variant* variant = &variants[v];
+			char* variantDir = variant->objectDir;
+
+			// The archive's command depends on what changed, only its flags and members say whether it has to run
+			char* cmd = NULL;
+			size_t cmdLen = 0;
+			if (staticLib) {
+				cmd = thinArchive ? COMP_AR_THIN_FLAGS : COMP_AR_FLAGS;
+				cmdLen = StrLen(cmd) + 1;
+			} else {
+				// Past the threshold the inputs go to '@file' instead, written straight from the tables without joining them
+				char* objFilesStr = NULL;
+				char* libsStr = NULL;
+				size_t inputsLen = JoinedLenStrList(&variant->objFiles, 0, true) + JoinedLenStrList(&sysLibsSplitted, StrLen(COMP_LIB_PREFIX), false);
+				if (inputsLen > COMP_RSP_THRESHOLD) {
+					const char* rspPathFmt = (variantDir[0] != '\0') ? "%s/%s.rsp" : "%s%s.rsp";
+					size_t rspPathLen = 1 + snprintf(NULL, 0, rspPathFmt, variantDir, outputFile);
+					char* rspPath = (char*) ArenaAlloc(&arena, rspPathLen);
+					snprintf(rspPath, rspPathLen, rspPathFmt, variantDir, outputFile);
+					if (!WriteResponseFile(rspPath, &variant->objFiles, &sysLibsSplitted)) {
+						fprintf(stderr, "Error trying to write response file '%s'\n", rspPath);
+						return -1;
+					}
 
-				objFilesStrOffset += fileLen + 1;
+					// The linker runs inside the output dir
+					size_t rspArgLen = 1 + snprintf(NULL, 0, "@%s.rsp", outputFile);
+					objFilesStr = (char*) ArenaAlloc(&arena, rspArgLen);
+					snprintf(objFilesStr, rspArgLen, "@%s.rsp", outputFile);
+					libsStr = "";
+				} else {
+					objFilesStr = JoinStrList(&arena, &variant->objFiles, "", true);
+					libsStr = JoinStrList(&arena, &sysLibsSplitted, COMP_LIB_PREFIX, false);
+				}
+
+				// Every compile slot is idle once the loop above is done, so the LTO backends of the variants share all of them
+				size_t freeSlots = thrdCount / variantCount > 0 ? thrdCount / variantCount : 1;
+				variant->ltoFlags = GetLtoFlags(&arena, compiler, variant->linkFlags, ltoJobs, freeSlots, ltoPart, ltoCache);
+				char* ltoFlagsStr = variant->ltoFlags != NULL ? variant->ltoFlags : "";
+
+				// The linker's own threads get the same slots, LTO backends and linking don't overlap
+				char* linkProgram = NULL;
+				variant->linkerFlags = GetLinkerFlags(&arena, compiler, linker, variant->linkFlags, freeSlots, incrementalLink, &linkProgram);
+				char* linkerFlagsStr = variant->linkerFlags != NULL ? variant->linkerFlags : "";
+				if (linkProgram == NULL)
+					linkProgram = COMP_LINK;
+
+				// The linker runs inside the output dir, so a relative cache path is relative to it as well
+				if (variant->ltoFlags != NULL && ltoCache != NULL) {
+					const char* pathFmt = (ltoCache[0] == '/' || variantDir[0] == '\0') ? "%.0s%s" : "%s/%s";
+					size_t pathLen = 1 + snprintf(NULL, 0, pathFmt, variantDir, ltoCache);
+					variant->ltoCachePath = (char*) ArenaAlloc(&arena, pathLen);
+					snprintf(variant->ltoCachePath, pathLen, pathFmt, variantDir, ltoCache);
+
+					GetCacheDirStats(variant->ltoCachePath, 0, &variant->ltoCacheEntries, &variant->ltoCacheTouched);
+				}
+
+				const char* cmdFmt = "%s %s %s %s %s%s %s %s";
+				cmdLen = 1 + snprintf(NULL, 0, cmdFmt, linkProgram, variant->linkFlags, linkerFlagsStr, ltoFlagsStr, COMP_OUT, variant->outputArg, libsStr, objFilesStr);
+				cmd = (char*) ArenaAlloc(&arena, cmdLen);
+				snprintf(cmd, cmdLen, cmdFmt, linkProgram, variant->linkFlags, linkerFlagsStr, ltoFlagsStr, COMP_OUT, variant->outputArg, libsStr, objFilesStr);
 			}
 
-			char* libsStr = GetLibsStr(sysLibsSplitted);
+			// The compiles that ran are right before the link, the clean ones after it
+			Job* linkJob = &variant->jobs[variant->dirtyCount];
+			linkJob->name = outputFile;
+			linkJob->cmd = cmd;
+			linkJob->workDir = variantDir;
+			linkJob->category = "link";
+			// A response file keeps the command the same when the objects change, so they are hashed as well
+			linkJob->hash = HashStr(cmd, cmdLen - 1, toolchainHash);
+			linkJob->hash = HashStr(variant->objFiles.buffer, variant->objFiles.bufferSize, linkJob->hash);
+
+			// The clean units' objects are what the last build wrote, a recompiled one only counts when its bytes changed
+			size_t changedCount = 0;
+			for (size_t i = 0; i < jobCount + 1; i += 1) {
+				if (i == variant->dirtyCount)
+					continue;
+
+				Job* job = &variant->jobs[i];
+				uint64_t prevHash = 0;
+				uint64_t prevContent = 0;
+				if (i > variant->dirtyCount)
+					FindBuildState(&variant->state, job->name, &prevHash, NULL, &job->contentHash);
+				else if (!FindBuildState(&variant->state, job->name, &prevHash, NULL, &prevContent) || prevContent != job->contentHash)
+					changedCount += 1;
+			}
+			linkJob->contentHash = HashLinkInputs(variant->jobs, jobCount + 1, variant->dirtyCount);
+
+			uint64_t outputTime = 0;
+			uint64_t prevHash = 0;
+			uint64_t prevDurationUs = 0;
+			uint64_t prevContent = 0;
+			bool outputExists = GetFileModTime(variant->outputPath, &outputTime);
+			bool recorded = FindBuildState(&variant->state, linkJob->name, &prevHash, &prevDurationUs, &prevContent);
+			variant->linkRuns = !outputExists || !recorded || prevHash != linkJob->hash || prevContent != linkJob->contentHash;
+
+			// Unless the members or flags changed, the archive only needs its changed members replaced
+			if (staticLib && variant->linkRuns) {
+				bool update = outputExists && recorded && prevHash == linkJob->hash && (thinArchive || !HasSameNamedMembers(&arena, &variant->objFiles));
+				Str_List changed = {0};
+				if (update) {
+					for (size_t i = 0; i < variant->dirtyCount; i += 1) {
+						Job* job = &variant->jobs[i];
+						uint64_t memberHash = 0;
+						uint64_t memberContent = 0;
+						if (!FindBuildState(&variant->state, job->name, &memberHash, NULL, &memberContent) || memberContent != job->contentHash)
+							PushStrList(&arena, &changed, job->output, StrLen(job->output));
+					}
+				} else {
+					remove(variant->outputPath);
+				}
 
-			const char* cmdFmt = "%s %s %s%s%s %s %s";
-			size_t cmdLen = 1 + snprintf(NULL, 0, cmdFmt, COMP_LINK, linkFlags, COMP_OUT, outputFile, COMP_EXE_EXT, libsStr, objFilesStr);
-			char* cmd = (char*) malloc(cmdLen);
-			snprintf(cmd, cmdLen, cmdFmt, COMP_LINK, linkFlags, COMP_OUT, outputFile, COMP_EXE_EXT, libsStr, objFilesStr);
+				linkJob->cmd = FormatArchiveCmd(&arena, variantDir, variant->outputArg, update ? &changed : &variant->objFiles, thinArchive, update);
+				if (linkJob->cmd == NULL)
+					return -1;
+				linkJob->category = "archive";
+			}
+			if (variant->linkRuns) {
+				linkPool[linkCount] = linkJob;
+				linkCount += 1;
+			} else if (variant->dirtyCount > 0 && changedCount == 0) {
+				printf("'%s' is up to date, skipped the link for %zu identical objects\n", variant->outputPath, variant->dirtyCount);
+			} else if (prevDurationUs > 0) {
+				printf("'%s' is up to date, skipped a %.3f s link\n", variant->outputPath, (double) prevDurationUs / 1000000.0);
+			} else {
+				printf("'%s' is up to date\n", variant->outputPath);
+			}
+
+			// dwp only reads the '.dwo' files the objects point at, so it packages them next to the link instead of after it
+			if (debugPackage && variant->splitDebug && !staticLib && COMP_DWP != NULL) {
+				char* dwoFilesStr = NULL;
+				if (JoinedLenStrList(&variant->dwoFiles, 0, true) > COMP_RSP_THRESHOLD) {
+					const char* rspPathFmt = (variantDir[0] != '\0') ? "%s/%s.dwp.rsp" : "%s%s.dwp.rsp";
+					size_t rspPathLen = 1 + snprintf(NULL, 0, rspPathFmt, variantDir, outputFile);
+					char* rspPath = (char*) ArenaAlloc(&arena, rspPathLen);
+					snprintf(rspPath, rspPathLen, rspPathFmt, variantDir, outputFile);
+					if (!WriteResponseFile(rspPath, &variant->dwoFiles, NULL)) {
+						fprintf(stderr, "Error trying to write response file '%s'\n", rspPath);
+						return -1;
+					}
+
+					size_t rspArgLen = 1 + snprintf(NULL, 0, "@%s.dwp.rsp", outputFile);
+					dwoFilesStr = (char*) ArenaAlloc(&arena, rspArgLen);
+					snprintf(dwoFilesStr, rspArgLen, "@%s.dwp.rsp", outputFile);
+				} else {
+					dwoFilesStr = JoinStrList(&arena, &variant->dwoFiles, "", true);
+				}
 
-			Process_Data linkerProcess = {0};
-			bool ok = SpawnAsyncProcess(cmd, outputDir, &linkerProcess);
-			if (!ok) {
-				fprintf(stderr, "Error trying to link '%s%s'\n", outputFile, COMP_EXE_EXT);
+				size_t dwpNameLen = 1 + snprintf(NULL, 0, "%s.dwp", variant->outputArg);
+				char* dwpName = (char*) ArenaAlloc(&arena, dwpNameLen);
+				snprintf(dwpName, dwpNameLen, "%s.dwp", variant->outputArg);
+
+				const char* packageFmt = "%s -o %s %s";
+				size_t packageLen = 1 + snprintf(NULL, 0, packageFmt, COMP_DWP, dwpName, dwoFilesStr);
+				char* packageCmd = (char*) ArenaAlloc(&arena, packageLen);
+				snprintf(packageCmd, packageLen, packageFmt, COMP_DWP, dwpName, dwoFilesStr);
+
+				Job* packageJob = &variant->packageJob;
+				packageJob->name = dwpName;
+				packageJob->cmd = packageCmd;
+				packageJob->workDir = variantDir;
+				packageJob->category = "package";
+
+				// Whatever the link rewrites, the package has to follow
+				size_t dwpPathLen = 1 + snprintf(NULL, 0, "%s.dwp", variant->outputPath);
+				char* dwpPath = (char*) ArenaAlloc(&arena, dwpPathLen);
+				snprintf(dwpPath, dwpPathLen, "%s.dwp", variant->outputPath);
+				variant->packageRuns = variant->linkRuns || !IsFileValid(dwpPath);
+				if (variant->packageRuns) {
+					linkPool[linkCount] = packageJob;
+					linkCount += 1;
+				}
+			}
+		}
+
+		// No unit changed but the output has to be written again, so the objects gone from RAM come back first
+		Job** evictedPool = (Job**) ArenaAlloc(&arena, sizeof(Job*) * (jobCount * variantCount + 1));
+		size_t evictedCount = 0;
+		for (size_t v = 0; v < variantCount; v += 1) {
+			Build_Variant* variant = &variants[v];
+			if (variant->evictedCount == 0 || (!variant->linkRuns && !variant->packageRuns))
+				continue;
+
+			Job* cleanJobs = &variant->jobs[variant->dirtyCount + 1];
+			size_t cleanCount = jobCount - variant->dirtyCount;
+			if (!CreateOutputDirs(cleanJobs, cleanCount, variant->objectDir)) {
+				fprintf(stderr, "Error trying to create the object dirs in '%s'\n", variant->objectDir);
+				return -1;
+			}
+			for (size_t i = 0; i < cleanCount; i += 1) {
+				char objectPath[4096];
+				snprintf(objectPath, sizeof(objectPath), "%s/%s", variant->objectDir, cleanJobs[i].output);
+				char sidePath[4096];
+				if (cleanJobs[i].sideOutput != NULL)
+					snprintf(sidePath, sizeof(sidePath), "%s/%s", variant->objectDir, cleanJobs[i].sideOutput);
+				if (!IsFileValid(objectPath) || (cleanJobs[i].sideOutput != NULL && !IsFileValid(sidePath))) {
+					evictedPool[evictedCount] = &cleanJobs[i];
+					evictedCount += 1;
+				}
+			}
+		}
+		if (evictedCount > 0) {
+			printf("Rebuilding %zu objects evicted from '%s'\n", evictedCount, ramDir);
+			bool evictedOk = RunJobs(evictedPool, evictedCount, thrdCount, &remote, compilePlacement, &trace);
+			for (size_t i = 0; i < evictedCount; i += 1) {
+				if (evictedPool[i]->endUs != 0 && evictedPool[i]->stats.exitCode == 0)
+					evictedPool[i]->contentHash = HashJobOutput(evictedPool[i]);
+			}
+			if (!evictedOk) {
+				for (size_t v = 0; v < variantCount; v += 1)
+					WriteBuildState(variants[v].statePath, variants[v].jobs, jobCount + 1, &variants[v].state);
+				fprintf(stderr, "Error trying to compile '%s%s'\n", outputFile, outputExt);
 				return -1;
 			}
 
-			WaitForMultipleProcesses(&linkerProcess, 1);
+			// What the link reads is what came back, not what was recorded
+			for (size_t v = 0; v < variantCount; v += 1) {
+				Build_Variant* variant = &variants[v];
+				if (variant->evictedCount > 0)
+					variant->jobs[variant->dirtyCount].contentHash = HashLinkInputs(variant->jobs, jobCount + 1, variant->dirtyCount);
+			}
+		}
+
+		uint64_t linkStart = GetSystemTimeNs();
+		bool ok = RunJobs(linkPool, linkCount, thrdCount, NULL, linkPlacement, &trace);
+		for (size_t v = 0; v < variantCount; v += 1) {
+			Build_Variant* variant = &variants[v];
+			WriteBuildState(variant->statePath, variant->jobs, jobCount + 1, &variant->state);
+
+			if (ok && variant->linkRuns && variant->ltoCachePath != NULL) {
+				size_t entriesAfter = 0;
+				size_t touchedAfter = 0;
+				if (GetCacheDirStats(variant->ltoCachePath, linkStart, &entriesAfter, &touchedAfter)) {
+					// New entries are misses, old entries touched by the linker are hits
+					size_t misses = entriesAfter > variant->ltoCacheEntries ? entriesAfter - variant->ltoCacheEntries : 0;
+					size_t hits = touchedAfter > misses ? touchedAfter - misses : 0;
+					double hitRate = (hits + misses) > 0 ? 100.0 * (double) hits / (double) (hits + misses) : 0.0;
+					printf("LTO cache: %zu hits, %zu misses (%.1f%% hit rate)\n", hits, misses, hitRate);
+				}
+			}
+		}
 
-			//free(cmd);
-			//free(libsStr);
-			//free(objFilesStr);
-			//DestroyStrList(&objFiles);
-			//free(objPath);
+		if (!ok) {
+			fprintf(stderr, "Error trying to link '%s%s'\n", outputFile, outputExt);
+			return -1;
+		}
+	}
+	TraceEndPhase(&trace, &linkPhase);
+	TraceEndPhase(&trace, &buildPhase);
+
+	if (tracePath != NULL) {
+		if (!WriteTrace(&trace, tracePath))
+			fprintf(stderr, "Error trying to write trace file '%s'\n", tracePath);
+		DestroyTrace(&trace);
+	}
+
+	if (printSummary || summaryPath != NULL) {
+		uint64_t wallUs = GetTimeUs() - buildPhase.startUs;
+		// The jobs that ran, side by side
+		Job* ranJobs = (Job*) ArenaAlloc(&arena, sizeof(Job) * (totalDirty + linkCount + 1));
+		size_t ranCount = 0;
+		size_t* variantEnds = (size_t*) ArenaAlloc(&arena, sizeof(size_t) * variantCount);
+		for (size_t v = 0; v < variantCount; v += 1) {
+			size_t variantRan = variants[v].dirtyCount + (variants[v].linkRuns ? 1 : 0);
+			MemCpy(&ranJobs[ranCount], variants[v].jobs, sizeof(Job) * variantRan);
+			ranCount += variantRan;
+			if (variants[v].packageRuns) {
+				ranJobs[ranCount] = variants[v].packageJob;
+				ranCount += 1;
+			}
+			variantEnds[v] = ranCount;
 		}
 
-		//DestroyStrList(&sourcesSplitted);
-		//DestroyStrList(&sysLibsSplitted);
-		//free(outputFile);
-		//free(outputDir);
-		//ini_destroy(config);
-		//free(fileData);
+		size_t skippedUnits = jobCount * variantCount - totalDirty;
+		Build_Summary summary = ComputeBuildSummary(ranJobs, ranCount, variantEnds, variantCount, thrdCount + remote.slotCount, wallUs, skippedUnits);
+		if (printSummary)
+			PrintBuildSummary(&summary);
+		if (summaryPath != NULL && !WriteBuildSummaryJson(&summary, summaryPath))
+			fprintf(stderr, "Error trying to write build summary '%s'\n", summaryPath);
+		DestroyBuildSummary(&summary);
 	}
 
+	DestroyJobPlacement(compilePlacement);
+	DestroyJobPlacement(linkPlacement);
+	DestroyArena(&arena);
+	UnmapFile(&buildData);
+
 	return 0;
 }
 
+// Objects, dependency files and the state go to '<ramDir>/<hash of the output dir>', only the output is written
+// to the output dir. With 'keepState' the state and dependency files stay there as well, so after the RAM dir
+// is gone the objects only come back once the output has to be built again.
+bool SetRamObjectDir(Arena* arena, char* ramDir, bool keepState, Build_Variant* variant)
+{
+	char* outputDir = variant->outputDir[0] != '\0' ? variant->outputDir : ".";
+	if (!CreateDirRecursive(outputDir))
+		return false;
+
+	char* fullOutputDir = GetFullPath(arena, outputDir);
+	if (fullOutputDir == NULL)
+		return false;
+
+	unsigned long long dirHash = HashStr(fullOutputDir, StrLen(fullOutputDir), HASH_SEED);
+	size_t objectDirLen = 1 + snprintf(NULL, 0, "%s/%016llx", ramDir, dirHash);
+	variant->objectDir = (char*) ArenaAlloc(arena, objectDirLen);
+	snprintf(variant->objectDir, objectDirLen, "%s/%016llx", ramDir, dirHash);
+	if (!CreateDirRecursive(variant->objectDir))
+		return false;
+
+	if (keepState) {
+		variant->depDir = fullOutputDir;
+	} else {
+		size_t statePathLen = 1 + snprintf(NULL, 0, "%s/%s", variant->objectDir, STATE_FILE_NAME);
+		variant->statePath = (char*) ArenaAlloc(arena, statePathLen);
+		snprintf(variant->statePath, statePathLen, "%s/%s", variant->objectDir, STATE_FILE_NAME);
+	}
+
+	return true;
+}
+
+// Runs 'job' locally once everything else is done, with every CPU and no memory limit
+static bool _RunJobAlone(Job* job, Job_Placement* placement, Trace* trace)
+{
+	Process_Data process = {0};
+	job->startUs = GetTimeUs();
+	job->slot = 0;
+	char* capturePath = COMP_DEP_STDOUT ? job->depFile : NULL;
+	if (!SpawnAsyncProcess(job->cmd, job->workDir, capturePath, placement, PLACEMENT_ALONE, &process)) {
+		fprintf(stderr, "Error trying to run '%s'\n", job->name);
+		return false;
+	}
+
+	Process_Stats stats = {0};
+	if (WaitForAnyProcess(&process, 1, &stats) != 0)
+		return false;
+
+	job->endUs = GetTimeUs();
+	job->stats = stats;
+	TraceAddSpan(trace, job->name, job->category, job->slot + 1, job->startUs, job->endUs, &job->stats);
+	if (capturePath != NULL && !ConvertShowIncludes(capturePath, job->workDir, job->output)) {
+		fprintf(stderr, "Error trying to write dependency file '%s'\n", capturePath);
+		return false;
+	}
+
+	return stats.exitCode == 0;
+}
+
+// Remote slots come after the local ones and only take the jobs that can run on a worker, those go there first
+bool RunJobs(Job** jobs, size_t jobCount, size_t slotCount, Remote_Pool* remote, Job_Placement* placement, Trace* trace)
+{
+	if (slotCount > jobCount)
+		slotCount = jobCount;
+	if (slotCount > MAX_RUNNING_JOBS)
+		slotCount = MAX_RUNNING_JOBS;
+	if (slotCount == 0)
+		return true;
+
+	size_t remoteSlots = (remote != NULL) ? remote->slotCount : 0;
+	if (remoteSlots > MAX_RUNNING_JOBS - slotCount)
+		remoteSlots = MAX_RUNNING_JOBS - slotCount;
+	size_t totalSlots = slotCount + remoteSlots;
+	Process_Data* running = (Process_Data*) malloc(sizeof(Process_Data) * totalSlots);
+	Job** runningJobs = (Job**) malloc(sizeof(Job*) * totalSlots);
+	bool* busySlots = (bool*) malloc(sizeof(bool) * totalSlots);
+	MemZero(busySlots, sizeof(bool) * totalSlots);
+	// Jobs killed for going past their memory limit, tried again one by one at the end
+	Job** oomJobs = (Job**) malloc(sizeof(Job*) * jobCount);
+	size_t oomCount = 0;
+	// Jobs a remote slot handed back, they wait for a local slot
+	Job** localJobs = (Job**) malloc(sizeof(Job*) * jobCount);
+	size_t localCount = 0;
+
+	size_t runningCount = 0;
+	size_t nextJob = 0;
+	bool ok = true;
+	while (true) {
+		// Keep every slot busy, a finished job frees its slot for the next one right away
+		while (ok && runningCount < totalSlots) {
+			size_t localSlot = totalSlots;
+			for (size_t i = 0; i < slotCount && localSlot == totalSlots; i += 1)
+				localSlot = busySlots[i] ? localSlot : i;
+
+			// Handed back jobs go first, the next job may still take a remote slot while the local ones are busy
+			Job* job = NULL;
+			size_t slot = totalSlots;
+			bool handedBack = localCount > 0 && localSlot != totalSlots;
+			if (handedBack) {
+				job = localJobs[localCount - 1];
+				slot = localSlot;
+			} else if (nextJob < jobCount) {
+				job = jobs[nextJob];
+				if (job->remoteArgs != NULL) {
+					for (size_t i = slotCount; i < totalSlots && slot == totalSlots; i += 1)
+						slot = busySlots[i] ? slot : i;
+				}
+				if (slot == totalSlots)
+					slot = localSlot;
+			}
+			if (slot == totalSlots)
+				break;
+
+			char* cmd = (slot >= slotCount) ? FormatDispatchCmd(remote, slot - slotCount, job) : job->cmd;
+			// Remote jobs never capture, the worker only runs where the compiler writes its own dependency file
+			char* capturePath = (COMP_DEP_STDOUT && slot < slotCount) ? job->depFile : NULL;
+			uint64_t spawnStart = GetTimeUs();
+			bool spawned = SpawnAsyncProcess(cmd, job->workDir, capturePath, placement, slot, &running[runningCount]);
+			if (cmd != job->cmd)
+				free(cmd);
+			if (!spawned) {
+				fprintf(stderr, "Error trying to run '%s'\n", job->name);
+				ok = false;
+				break;
+			}
+
+			job->startUs = GetTimeUs();
+			job->slot = slot;
+			TraceAddSpan(trace, job->name, "spawn", TRACE_LANE_MAIN, spawnStart, job->startUs, NULL);
+
+			busySlots[slot] = true;
+			runningJobs[runningCount] = job;
+			runningCount += 1;
+			if (handedBack)
+				localCount -= 1;
+			else
+				nextJob += 1;
+		}
+
+		if (runningCount == 0)
+			break;
+
+		Process_Stats stats = {0};
+		size_t done = WaitForAnyProcess(running, runningCount, &stats);
+		if (done >= runningCount) {
+			ok = false;
+			break;
+		}
+
+		Job* job = runningJobs[done];
+		job->endUs = GetTimeUs();
+		job->stats = stats;
+		busySlots[job->slot] = false;
+		TraceAddSpan(trace, job->name, job->category, job->slot + 1, job->startUs, job->endUs, &job->stats);
+		// The diagnostics are in the capture as well, so it's converted whether the compile worked or not
+		if (COMP_DEP_STDOUT && job->slot < slotCount && job->depFile != NULL && !ConvertShowIncludes(job->depFile, job->workDir, job->output)) {
+			fprintf(stderr, "Error trying to write dependency file '%s'\n", job->depFile);
+			ok = false;
+		}
+		// A failed job stops the build, but the ones already running get to finish. A remote job's preprocessor
+		// runs here under the same limit, when it got killed the job is tried again like any other.
+		if (job->slot >= slotCount && stats.exitCode == REMOTE_EXIT_LOCAL) {
+			localJobs[localCount] = job;
+			localCount += 1;
+		} else if (stats.oomKilled) {
+			fprintf(stderr, "Warning: '%s' ran out of memory after %llu KB, trying it again on its own\n", job->name,
+				(unsigned long long) stats.maxRssKb);
+			oomJobs[oomCount] = job;
+			oomCount += 1;
+		} else if (stats.exitCode != 0) {
+			ok = false;
+		}
+
+		runningCount -= 1;
+		running[done] = running[runningCount];
+		runningJobs[done] = runningJobs[runningCount];
+	}
+
+	for (size_t i = 0; i < oomCount && ok; i += 1)
+		ok = _RunJobAlone(oomJobs[i], placement, trace);
+
+	free(localJobs);
+	free(oomJobs);
+	free(busySlots);
+	free(runningJobs);
+	free(running);
+
+	return ok;
+}
+
 char* GetIniProp(ini_t* ini, int sec, const char* name)
 {
 	int prop = ini_find_property(ini, sec, name, 0);
@@ -251,27 +1278,123 @@ char* GetIniProp(ini_t* ini, int sec, const char* name)
 	return (char*) ini_property_value(ini, sec, prop);
 }
 
+char* GetIniPropOpt(ini_t* ini, int sec, const char* name, char* defaultValue)
+{
+	int prop = ini_find_property(ini, sec, name, 0);
+	if (!CHECK_INI(prop))
+		return defaultValue;
+
+	return (char*) ini_property_value(ini, sec, prop);
+}
+
+static char* _AppendFlags(Arena* arena, char* flags, char* extra)
+{
+	if (extra == NULL)
+		return flags;
+
+	size_t flagsLen = StrLen(flags);
+	size_t extraLen = StrLen(extra);
+	char* result = (char*) ArenaAlloc(arena, flagsLen + extraLen + 2);
+	MemCpy(result, flags, flagsLen);
+	result[flagsLen] = ' ';
+	MemCpy(&result[flagsLen + 1], extra, extraLen + 1);
+
+	return result;
+}
+
+// 'debugInfo' is 'full', 'split', 'compressed' or 'none', NULL leaves the flags as they are
+static bool _ApplyDebugInfo(Arena* arena, char* debugInfo, Build_Variant* variant)
+{
+	if (debugInfo == NULL || StrCmp(debugInfo, "none"))
+		return true;
+
+	char* compDebug = COMP_DEBUG_FULL;
+	char* linkDebug = COMP_DEBUG_LINK;
+	if (StrCmp(debugInfo, "split") || StrCmp(debugInfo, "compressed")) {
+		bool split = StrCmp(debugInfo, "split");
+		char* modeFlags = split ? COMP_DEBUG_SPLIT : COMP_DEBUG_COMPRESSED;
+		if (modeFlags != NULL) {
+			compDebug = modeFlags;
+			linkDebug = split ? COMP_DEBUG_LINK : COMP_DEBUG_LINK_COMPRESSED;
+			variant->splitDebug = split;
+		} else {
+			fprintf(stderr, "Warning: 'debugInfo = %s' isn't supported on this platform, using 'full'\n", debugInfo);
+		}
+	} else if (!StrCmp(debugInfo, "full")) {
+		fprintf(stderr, "Invalid 'debugInfo = %s', expected 'split', 'compressed', 'full' or 'none'\n", debugInfo);
+		return false;
+	}
+
+	variant->compFlags = _AppendFlags(arena, variant->compFlags, compDebug);
+	variant->linkFlags = _AppendFlags(arena, variant->linkFlags, linkDebug);
+
+	return true;
+}
+
+// A named variant appends the flags of '[Variant.<name>]' and its OS section to the program ones,
+// and builds into '<outputDir>/<name>'. The unnamed one is the program as it is.
+bool LoadVariant(Arena* arena, ini_t* ini, char* name, char* outputDir, char* compFlags, char* linkFlags, char* debugInfo, Build_Variant* variant)
+{
+	MemZero(variant, sizeof(Build_Variant));
+	variant->name = name;
+	variant->outputDir = outputDir;
+	variant->compFlags = compFlags;
+	variant->linkFlags = linkFlags;
+
+	if (name != NULL) {
+		char secName[256];
+		snprintf(secName, sizeof(secName), SEC_VARIANT, name);
+		int sec = ini_find_section(ini, secName, 0);
+		snprintf(secName, sizeof(secName), SEC_OS_VARIANT, name);
+		int osSec = ini_find_section(ini, secName, 0);
+		if (!CHECK_INI(sec) && !CHECK_INI(osSec)) {
+			fprintf(stderr, "Unknown variant '%s'\n", name);
+			return false;
+		}
+
+		if (CHECK_INI(sec)) {
+			variant->compFlags = _AppendFlags(arena, variant->compFlags, GetIniPropOpt(ini, sec, PROP_OS_CFLAGS, NULL));
+			variant->linkFlags = _AppendFlags(arena, variant->linkFlags, GetIniPropOpt(ini, sec, PROP_OS_LFLAGS, NULL));
+			debugInfo = GetIniPropOpt(ini, sec, PROP_OS_DEBUG_INFO, debugInfo);
+		}
+		if (CHECK_INI(osSec)) {
+			variant->compFlags = _AppendFlags(arena, variant->compFlags, GetIniPropOpt(ini, osSec, PROP_OS_CFLAGS, NULL));
+			variant->linkFlags = _AppendFlags(arena, variant->linkFlags, GetIniPropOpt(ini, osSec, PROP_OS_LFLAGS, NULL));
+			debugInfo = GetIniPropOpt(ini, osSec, PROP_OS_DEBUG_INFO, debugInfo);
+		}
+
+		const char* dirFmt = (outputDir[0] != '\0') ? "%s/%s" : "%s%s";
+		size_t dirLen = 1 + snprintf(NULL, 0, dirFmt, outputDir, name);
+		variant->outputDir = (char*) ArenaAlloc(arena, dirLen);
+		snprintf(variant->outputDir, dirLen, dirFmt, outputDir, name);
+	}
+
+	const char* statePathFmt = (variant->outputDir[0] != '\0') ? "%s/%s" : "%s%s";
+	size_t statePathLen = 1 + snprintf(NULL, 0, statePathFmt, variant->outputDir, STATE_FILE_NAME);
+	variant->statePath = (char*) ArenaAlloc(arena, statePathLen);
+	snprintf(variant->statePath, statePathLen, statePathFmt, variant->outputDir, STATE_FILE_NAME);
+
+	variant->objectDir = variant->outputDir;
+
+	if (!_ApplyDebugInfo(arena, debugInfo, variant))
+		return false;
+
+	return LoadFlagTable(arena, ini, variant->compFlags, SEC_FLAGS, SEC_OS_FLAGS, PROP_OS_CFLAGS, &variant->flagTable);
+}
 
-// TODO: No memory allocation
+// Points into 'path', it's only valid as long as 'path' is
 char* GetFilenameFromPath(char* path)
 {
-	size_t lastSlash = 0;
-	size_t lenght = 0;
+	char* filename = path;
 	for (size_t i = 0; path[i] != '\0'; i += 1) {
-		lenght += 1;
 		if (path[i] == '/')
-			lastSlash = i;
+			filename = &path[i + 1];
 	}
 
-	size_t size = lenght - lastSlash;
-	char* filename = (char*) malloc(size);
-	MemZero(filename, size);
-	MemCpy(filename, &path[lastSlash + 1], size);
-
 	return filename;
 }
 
-char* GetDirFromPath(char* path)
+char* GetDirFromPath(Arena* arena, char* path)
 {
 	size_t lastSlash = 0;
 	for (size_t i = 0; path[i] != '\0'; i += 1) {
@@ -279,44 +1402,56 @@ char* GetDirFromPath(char* path)
 			lastSlash = i;
 	}
 
-	char* dir = (char*) malloc(lastSlash + 1);
-	MemZero(dir, lastSlash + 1);
-	MemCpy(dir, path, lastSlash);
+	return ArenaStrDup(arena, path, lastSlash);
+}
+
+// A byte count with an optional 'K', 'M', 'G' or 'T' suffix, powers of 1024 like cgroups take them
+bool ParseByteSize(char* value, uint64_t* size)
+{
+	if (value[0] < '0' || value[0] > '9')
+		return false;
+
+	char* end = NULL;
+	errno = 0;
+	uint64_t result = strtoull(value, &end, 10);
+	if (errno == ERANGE)
+		return false;
+
+	if (*end != '\0') {
+		const char* units = "KMGT";
+		char* unit = strchr(units, *end & ~0x20);
+		if (unit == NULL || *unit == '\0')
+			return false;
+
+		unsigned shift = 10 * (unsigned) (unit - units + 1);
+		if (result > (UINT64_MAX >> shift))
+			return false;
+
+		result <<= shift;
+		end += 1;
+	}
+
+	*size = result;
 
-	return dir;
+	return *end == '\0' && result > 0;
 }
 
-// TODO: No memory allocation
+// Points into 'file', NULL when there is no extension
 char* GetFileExtension(char* file)
 {
 	char* ext = NULL;
-	size_t fileLen = StrLen(file);
-	for (size_t i = fileLen; i > 0; i -= 1) {
-		if (file[i - 1] == '.') {
-			size_t extLen = fileLen - i;
-			ext = (char*) malloc(extLen);
-			StrCpy(ext, &file[fileLen - extLen]);
-			break;
-		}
+	for (size_t i = 0; file[i] != '\0'; i += 1) {
+		if (file[i] == '.')
+			ext = &file[i + 1];
 	}
 
 	return ext;
 }
 
-Str_List SplitStringList(char* strList)
+Str_List SplitStringList(Arena* arena, char* strList)
 {
-	size_t splits = 0;
-	for (size_t i = 0; strList[i] != '\0'; i += 1) {
-		if (strList[i] == ',')
-			splits += 1;
-	}
-
-	Str_List finalList = {
-		.data = (char**) malloc(sizeof(char*) * (splits + 1)),
-		.size = splits + 1,
-	};
+	Str_List finalList = {0};
 
-	size_t current = 0;
 	size_t offset = 0;
 	for (size_t i = 0; ; i += 1) {
 		if (strList[i] == ' ')
@@ -324,11 +1459,8 @@ Str_List SplitStringList(char* strList)
 
 		if (strList[i] == ',' || strList[i] == '\0') {
 			size_t size = i - offset;
-			finalList.data[current] = (char*) malloc(size + 1);
-			MemZero(finalList.data[current], size + 1);
-			MemCpy(finalList.data[current], &strList[i - size], size);
+			PushStrList(arena, &finalList, &strList[i - size], size);
 			offset = i + 1;
-			current += 1;
 
 			if (strList[i] == '\0')
 				break;
@@ -338,52 +1470,196 @@ Str_List SplitStringList(char* strList)
 	return finalList;
 }
 
-Str_List ParseFileList(char* sources)
+// Appends the files matching 'sources' to 'fileList', returns how many were added
+size_t ParseFileList(Arena* arena, Str_List* fileList, char* sources)
 {
-    Str_List fileList = {};
-    char* file = GetFilenameFromPath(sources);
+	char* file = GetFilenameFromPath(sources);
 
-    if (file[0] != '*') {
-		fileList.data = (char**) malloc(sizeof(char*) * 1);
-		fileList.data[0] = file;
-		fileList.size = 1;
+	if (file[0] != '*') {
+		PushStrList(arena, fileList, file, StrLen(file));
+		return 1;
+	}
+
+	bool recurse = MemCmp(file, "**", 2);
 
-		return fileList;
+	char* dir = GetDirFromPath(arena, sources);
+	char* ext = GetFileExtension(file);
+
+	return IterateDir(arena, recurse, fileList, dir, ext);
+}
+
+void PushStrList(Arena* arena, Str_List* list, const char* str, size_t len)
+{
+	// The arena can't grow in place, so the tables double to keep the copies amortized
+	if (list->size >= list->capacity) {
+		size_t capacity = list->capacity > 0 ? list->capacity * 2 : 64;
+		size_t* offsets = (size_t*) ArenaAlloc(arena, sizeof(size_t) * capacity);
+		size_t* lengths = (size_t*) ArenaAlloc(arena, sizeof(size_t) * capacity);
+		if (list->size > 0) {
+			MemCpy(offsets, list->offsets, sizeof(size_t) * list->size);
+			MemCpy(lengths, list->lengths, sizeof(size_t) * list->size);
+		}
+
+		list->offsets = offsets;
+		list->lengths = lengths;
+		list->capacity = capacity;
 	}
 
-    bool recurse = MemCmp(file, "**", 2);
+	if (list->bufferSize + len + 1 > list->bufferCapacity) {
+		size_t capacity = list->bufferCapacity > 0 ? list->bufferCapacity * 2 : 4096;
+		while (capacity < list->bufferSize + len + 1)
+			capacity *= 2;
 
-    char* dir = GetDirFromPath(sources);
-   	char* ext = GetFileExtension(file);
-	fileList.size = IterateDir(0, recurse, NULL, dir, ext);
-	if (fileList.size != 0) {
-		fileList.data = (char**) malloc(sizeof(char*) * fileList.size);
-		IterateDir(0, recurse, fileList.data, dir, ext);
+		char* buffer = (char*) ArenaAlloc(arena, capacity);
+		if (list->bufferSize > 0)
+			MemCpy(buffer, list->buffer, list->bufferSize);
+
+		list->buffer = buffer;
+		list->bufferCapacity = capacity;
 	}
 
-	free(ext);
-    free(dir);
-    free(file);
+	list->offsets[list->size] = list->bufferSize;
+	list->lengths[list->size] = len;
+	MemCpy(&list->buffer[list->bufferSize], str, len);
+	list->buffer[list->bufferSize + len] = '\0';
 
-    return fileList;
+	list->bufferSize += len + 1;
+	list->size += 1;
 }
 
-size_t FullLenStrList(Str_List list)
+// Space separated, the final size is known up front from the table so nothing gets measured twice
+char* JoinStrList(Arena* arena, Str_List* list, const char* prefix, bool quote)
 {
-    size_t listLen = 0;
-        for (size_t i = 0; i < list.size; i += 1)
-            listLen += StrLen(list.data[i]);
+	size_t prefixLen = StrLen(prefix);
+	char* joined = (char*) ArenaAlloc(arena, JoinedLenStrList(list, prefixLen, quote) + 1);
 
-    return listLen;
+	size_t offset = 0;
+	for (size_t i = 0; i < list->size; i += 1) {
+		if (i > 0)
+			joined[offset++] = ' ';
+
+		MemCpy(&joined[offset], prefix, prefixLen);
+		offset += prefixLen;
+		if (quote)
+			joined[offset++] = '\"';
+
+		MemCpy(&joined[offset], GetStrList(list, i), list->lengths[i]);
+		offset += list->lengths[i];
+		if (quote)
+			joined[offset++] = '\"';
+	}
+	joined[offset] = '\0';
+
+	return joined;
+}
+
+size_t JoinedLenStrList(Str_List* list, size_t prefixLen, bool quote)
+{
+	if (list->size == 0)
+		return 0;
+
+	return FullLenStrList(list) + list->size * (prefixLen + (quote ? 2 : 0)) + list->size - 1;
 }
 
-void DestroyStrList(Str_List* list)
+static void _WriteResponseArgs(FILE* file, Str_List* list, const char* prefix, bool quote)
 {
+	const char* escapes = COMP_RSP_ESCAPES;
 	for (size_t i = 0; i < list->size; i += 1) {
-		free(list->data[i]);
+		char* item = GetStrList(list, i);
+
+		fputs(prefix, file);
+		if (quote)
+			fputc('\"', file);
+
+		if (escapes[0] == '\0' || strpbrk(item, escapes) == NULL) {
+			fwrite(item, 1, list->lengths[i], file);
+		} else {
+			for (size_t j = 0; j < list->lengths[i]; j += 1) {
+				if (strchr(escapes, item[j]) != NULL)
+					fputc('\\', file);
+				fputc(item[j], file);
+			}
+		}
+
+		if (quote)
+			fputc('\"', file);
+		fputc('\n', file);
+	}
+}
+
+// One argument per line, understood by gcc, clang, ar and link.exe alike
+bool WriteResponseFile(char* path, Str_List* files, Str_List* libs)
+{
+	FILE* file = fopen(path, "w");
+	if (file == NULL)
+		return false;
+
+	_WriteResponseArgs(file, files, "", true);
+	if (libs != NULL)
+		_WriteResponseArgs(file, libs, COMP_LIB_PREFIX, false);
+
+	return fclose(file) == 0;
+}
+
+// A full archive only keeps the file names of its members, replacing one of two 'util.o' could hit either.
+// Names are compared by hash, a collision only costs a rebuild of the archive.
+bool HasSameNamedMembers(Arena* arena, Str_List* members)
+{
+	size_t capacity = 16;
+	while (capacity < members->size * 2)
+		capacity *= 2;
+
+	uint64_t* seen = (uint64_t*) ArenaAlloc(arena, sizeof(uint64_t) * capacity);
+	MemZero(seen, sizeof(uint64_t) * capacity);
+	for (size_t i = 0; i < members->size; i += 1) {
+		char* name = GetFilenameFromPath(GetStrList(members, i));
+		// Zero marks a free slot
+		uint64_t hash = HashStr(name, StrLen(name), HASH_SEED) | 1;
+		size_t slot = (size_t) hash & (capacity - 1);
+		while (seen[slot] != 0) {
+			if (seen[slot] == hash)
+				return true;
+			slot = (slot + 1) & (capacity - 1);
+		}
+		seen[slot] = hash;
 	}
 
-	free(list->data);
-	list->data = NULL;
-	list->size = 0;
+	return false;
+}
+
+// Runs inside 'workDir', the archive is relative to it or absolute. The members go through '@file' past the
+// threshold like the link inputs. With 'update' the archive already exists and only 'members' get replaced in it.
+char* FormatArchiveCmd(Arena* arena, char* workDir, char* archivePath, Str_List* members, bool thin, bool update)
+{
+	char* archiveName = GetFilenameFromPath(archivePath);
+	char* membersStr = NULL;
+	if (JoinedLenStrList(members, 0, true) > COMP_RSP_THRESHOLD) {
+		const char* rspPathFmt = (workDir[0] != '\0') ? "%s/%s.rsp" : "%s%s.rsp";
+		size_t rspPathLen = 1 + snprintf(NULL, 0, rspPathFmt, workDir, archiveName);
+		char* rspPath = (char*) ArenaAlloc(arena, rspPathLen);
+		snprintf(rspPath, rspPathLen, rspPathFmt, workDir, archiveName);
+		if (!WriteResponseFile(rspPath, members, NULL)) {
+			fprintf(stderr, "Error trying to write response file '%s'\n", rspPath);
+			return NULL;
+		}
+
+		size_t rspArgLen = 1 + snprintf(NULL, 0, "@%s.rsp", archiveName);
+		membersStr = (char*) ArenaAlloc(arena, rspArgLen);
+		snprintf(membersStr, rspArgLen, "@%s.rsp", archiveName);
+	} else {
+		membersStr = JoinStrList(arena, members, "", true);
+	}
+
+	char* flags = thin ? COMP_AR_THIN_FLAGS : COMP_AR_FLAGS;
+	const char* selfFmt = (update && COMP_AR_SELF) ? "\"%s\" " : "%.0s";
+	size_t selfLen = 1 + snprintf(NULL, 0, selfFmt, archivePath);
+	char* selfStr = (char*) ArenaAlloc(arena, selfLen);
+	snprintf(selfStr, selfLen, selfFmt, archivePath);
+
+	const char* cmdFmt = "%s %s %s\"%s\" %s%s";
+	size_t cmdLen = 1 + snprintf(NULL, 0, cmdFmt, COMP_AR, flags, COMP_AR_OUT, archivePath, selfStr, membersStr);
+	char* cmd = (char*) ArenaAlloc(arena, cmdLen);
+	snprintf(cmd, cmdLen, cmdFmt, COMP_AR, flags, COMP_AR_OUT, archivePath, selfStr, membersStr);
+
+	return cmd;
 }
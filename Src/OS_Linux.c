@@ -1,12 +1,17 @@
-#define _GNU_SOURCE
 #include <stdlib.h>
 #include <unistd.h>
 #include <dirent.h>
-#include <spawn.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <sched.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
 #include <sys/sysinfo.h>
+#include <sys/syscall.h>
+#include <time.h>
 
 char *realpath (const char *__restrict, char *__restrict);
 
@@ -24,19 +29,117 @@ bool IsDirValid(char* path)
     return (res == 0) && S_ISDIR(fileInfo.st_mode);
 }
 
+bool GetFileModTime(char* path, uint64_t* mtimeNs)
+{
+    struct stat fileInfo = {0};
+    if (stat(path, &fileInfo) != 0)
+        return false;
+
+    *mtimeNs = (uint64_t) fileInfo.st_mtim.tv_sec * 1000000000ull + (uint64_t) fileInfo.st_mtim.tv_nsec;
+    return true;
+}
+
+bool GetFileIdentity(char* path, File_Identity* identity)
+{
+    struct stat fileInfo = {0};
+    if (stat(path, &fileInfo) != 0)
+        return false;
+
+    identity->id = ((uint64_t) fileInfo.st_dev << 32) ^ (uint64_t) fileInfo.st_ino;
+    identity->mtimeNs = (uint64_t) fileInfo.st_mtim.tv_sec * 1000000000ull + (uint64_t) fileInfo.st_mtim.tv_nsec;
+    identity->size = (uint64_t) fileInfo.st_size;
+    return true;
+}
+
+bool CreateDirRecursive(char* path)
+{
+    char dir[PATH_MAX];
+    size_t pathLen = StrLen(path);
+    if (pathLen >= PATH_MAX)
+        return false;
+    MemCpy(dir, path, pathLen + 1);
+
+    for (size_t i = 1; i <= pathLen; i += 1) {
+        if (dir[i] != '/' && dir[i] != '\0')
+            continue;
+
+        char c = dir[i];
+        dir[i] = '\0';
+        if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+            return false;
+        dir[i] = c;
+    }
+
+    return true;
+}
+
+bool MapFile(char* path, Mapped_File* file)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return false;
+
+    struct stat fileInfo = {0};
+    if (fstat(fd, &fileInfo) != 0) {
+        close(fd);
+        return false;
+    }
+
+    file->size = (size_t) fileInfo.st_size;
+    file->mapped = false;
+
+    // A private mapping is copy-on-write, so the data can be modified in place. The bytes past the end of the
+    // file up to the page boundary are zero, that's where the terminator comes from, so full pages can't be mapped.
+    size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+    if (file->size > 0 && file->size % pageSize != 0) {
+        void* data = mmap(NULL, file->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            file->data = (char*) data;
+            file->mapped = true;
+            close(fd);
+
+            return true;
+        }
+    }
+
+    file->data = (char*) malloc(file->size + 1);
+    size_t offset = 0;
+    while (offset < file->size) {
+        ssize_t res = read(fd, &file->data[offset], file->size - offset);
+        if (res <= 0)
+            break;
+        offset += (size_t) res;
+    }
+    file->data[offset] = '\0';
+    close(fd);
+
+    return true;
+}
+
+void UnmapFile(Mapped_File* file)
+{
+    if (file->mapped)
+        munmap(file->data, file->size);
+    else
+        free(file->data);
+
+    file->data = NULL;
+    file->size = 0;
+}
+
 // Forward declaration
 char* GetFilenameFromPath(char* path);
-char* GetDirFromPath(char* path);
+char* GetDirFromPath(Arena* arena, char* path);
 char* GetFileExtension(char* file);
-size_t FullLenStrList(Str_List list);
 
-static char* _PathJoin(char* path1, char* path2)
+// Joins into a 'PATH_MAX' buffer owned by the caller, the paths never outlive the function using them
+static char* _PathJoin(char* finalPath, char* path1, char* path2)
 {
     size_t path1Len = StrLen(path1);
     size_t path2Len = StrLen(path2);
-    size_t finalLen = path1Len + path2Len + 2;
+    if (path1Len + path2Len + 2 > PATH_MAX)
+        return NULL;
 
-    char* finalPath = (char*) malloc(finalLen);
     MemCpy(&finalPath[0], path1, path1Len);
     MemCpy(&finalPath[path1Len + 1], path2, path2Len + 1);
     finalPath[path1Len] = '/';
@@ -44,9 +147,9 @@ static char* _PathJoin(char* path1, char* path2)
     return finalPath;
 }
 
-size_t IterateDir(size_t startIndex, bool recurse, char** fileList, char* path, char* ext)
+size_t IterateDir(Arena* arena, bool recurse, Str_List* fileList, char* path, char* ext)
 {
-    size_t entryIndex = startIndex;
+    size_t entryCount = 0;
     DIR* dir = opendir(path);
 
     struct dirent* entry = NULL;
@@ -54,134 +157,566 @@ size_t IterateDir(size_t startIndex, bool recurse, char** fileList, char* path,
         if (entry->d_type == DT_DIR) {
             // We want to skip the '.' and '..' directories
             if (recurse && !StrCmp(entry->d_name, ".") && !StrCmp(entry->d_name, "..")) {
-                char* subDir = _PathJoin(path, entry->d_name);
-                entryIndex = IterateDir(entryIndex, recurse, fileList, subDir, ext);
-                free(subDir);
+                char subDir[PATH_MAX];
+                if (_PathJoin(subDir, path, entry->d_name) != NULL)
+                    entryCount += IterateDir(arena, recurse, fileList, subDir, ext);
             }
 
             continue;
         }
 
         char* currExt = GetFileExtension(entry->d_name);
-        if (currExt != NULL) {
-            if (StrCmp(currExt, ext)) {
-                if (fileList != NULL) {
-                    char* relativePath = _PathJoin(path, entry->d_name);
-                    fileList[entryIndex] = malloc(PATH_MAX);
-
-                    realpath(relativePath, &fileList[entryIndex][1]);
-                    fileList[entryIndex][0] = '\"';
-                    fileList[entryIndex][StrLen(fileList[entryIndex])] = '\"';
-
-                    free(relativePath);
-                }
-
-                entryIndex += 1;
-            }
+        if (currExt != NULL && ext != NULL && StrCmp(currExt, ext)) {
+            char relativePath[PATH_MAX];
+            char fullPath[PATH_MAX];
+            if (_PathJoin(relativePath, path, entry->d_name) == NULL)
+                continue;
+            if (realpath(relativePath, fullPath) == NULL)
+                StrCpy(fullPath, relativePath);
+
+            PushStrList(arena, fileList, fullPath, StrLen(fullPath));
+            entryCount += 1;
         }
-
-        free(currExt);
     }
 
     closedir(dir);
 
-    return entryIndex;
+    return entryCount;
 }
 
-char* GetLibsStr(Str_List libs)
+char* GetFullPath(Arena* arena, char* path)
 {
-    const char* prefix = "-l";
-    const size_t prefixLen = sizeof("-l") - 1;
+    char fullPath[PATH_MAX];
+    if (realpath(path, fullPath) == NULL)
+        return NULL;
 
-	char* libsStr = (char*) malloc(libs.size * (prefixLen + 1) + FullLenStrList(libs));
-	size_t libsStrOffset = 0;
-	for (size_t i = 0; i < libs.size; i += 1) {
-	    size_t strLen = StrLen(libs.data[i]);
-	    MemCpy(&libsStr[libsStrOffset], prefix, prefixLen);
-		MemCpy(&libsStr[libsStrOffset + prefixLen], libs.data[i], strLen + 1);
-		if (i < libs.size - 1)
-		    libsStr[libsStrOffset + prefixLen + strLen] = ' ';
+    return ArenaStrDup(arena, fullPath, StrLen(fullPath));
+}
 
-		libsStrOffset += prefixLen + strLen + 1;
-	}
+char* GetExecutablePath(Arena* arena)
+{
+    char path[PATH_MAX];
+    ssize_t pathLen = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (pathLen <= 0)
+        return NULL;
 
-	return libsStr;
+    return ArenaStrDup(arena, path, (size_t) pathLen);
 }
 
 typedef struct Process_Data {
+    // The arguments live in one string table, 'argv' points straight into it
+    Arena argArena;
+    Str_List args;
     char** argv;
     pid_t pid;
+    // The job's own cgroup, NULL when it runs in ours
+    char* cgroupDir;
 } Process_Data;
 
-bool SpawnAsyncProcess(char* cmd, char* workDir, Process_Data* process)
+void DestroyProcess(Process_Data* process);
+
+// Splits 'cmd' by spaces, double quoted blocks are kept as a single argument
+static char** _SplitCmdArgs(Arena* arena, Str_List* args, char* cmd)
 {
-    char* program = NULL;
-    for (size_t i = 0; cmd[i] != '\0'; i += 1) {
+    size_t i = 0;
+    while (cmd[i] != '\0') {
         if (cmd[i] == ' ') {
-            program = (char*) malloc(i);
-            program[i] = '\0';
-            MemCpy(program, cmd, i);
-
-            size_t numOfArgs = 0;
-            for (size_t j = i; cmd[j] != '\0'; j += 1)
-                if (cmd[j] == ' ')
-                    numOfArgs += 1;
-
-            process->argv = malloc(sizeof(char*) * (numOfArgs + 1));
-            process->argv[0] = program;
-            process->argv[numOfArgs] = NULL;
-
-            bool insideBlock = false;
-            size_t lastSplit = i;
-            size_t argIdx = 1;
-            for (size_t j = i + 1; cmd[j] != '\0'; j += 1) {
-                size_t argLen = j - lastSplit - 1;
-
-                #define _AppendArg()\
-                    process->argv[argIdx] = malloc(argLen);\
-                    MemCpy(process->argv[argIdx], &cmd[j - argLen], argLen);\
-                    argIdx += 1
-
-                if (cmd[j] == '\"') {
-                    if (insideBlock) {
-                        _AppendArg();
-                        j += 1;
-                    }
-
-                    insideBlock = !insideBlock;
-                    lastSplit = j;
-                } else if (cmd[j] == ' ' && !insideBlock) {
-                    _AppendArg();
-                    lastSplit = j;
-                }
+            i += 1;
+            continue;
+        }
+
+        size_t start = i;
+        size_t end = i;
+        if (cmd[i] == '\"') {
+            start = i + 1;
+            for (end = start; cmd[end] != '\0' && cmd[end] != '\"'; end += 1);
+            i = (cmd[end] == '\"') ? end + 1 : end;
+        } else {
+            for (end = start; cmd[end] != '\0' && cmd[end] != ' '; end += 1);
+            i = end;
+        }
+
+        PushStrList(arena, args, &cmd[start], end - start);
+    }
+
+    // Every entry is NUL terminated in the table, so it's handed to 'execve()' as is
+    char** argv = (char**) ArenaAlloc(arena, sizeof(char*) * (args->size + 1));
+    for (size_t arg = 0; arg < args->size; arg += 1)
+        argv[arg] = GetStrList(args, arg);
+    argv[args->size] = NULL;
+
+    return argv;
+}
+
+typedef struct Program_Path {
+    char* name;
+    char* path;
+} Program_Path;
+
+#define PROGRAM_CACHE_SIZE 16
+static Program_Path _programCache[PROGRAM_CACHE_SIZE];
+static size_t _programCacheSize = 0;
+
+// Searches 'PATH' only the first time a program is seen, every spawn after that reuses the result
+char* ResolveProgramPath(char* program)
+{
+    for (size_t i = 0; i < _programCacheSize; i += 1)
+        if (StrCmp(_programCache[i].name, program))
+            return _programCache[i].path;
+
+    char* path = NULL;
+    if (strchr(program, '/') != NULL) {
+        if (access(program, X_OK) == 0)
+            path = strdup(program);
+    } else {
+        char* envPath = getenv("PATH");
+        char* dirs = strdup(envPath != NULL ? envPath : "/usr/local/bin:/usr/bin:/bin");
+        for (char* dir = strtok(dirs, ":"); dir != NULL; dir = strtok(NULL, ":")) {
+            char candidate[PATH_MAX];
+            if (_PathJoin(candidate, dir, program) != NULL && access(candidate, X_OK) == 0) {
+                path = strdup(candidate);
+                break;
             }
+        }
+
+        free(dirs);
+    }
+
+    // Relative paths would break once the child changes its working dir
+    if (path != NULL && path[0] != '/') {
+        char* absPath = realpath(path, NULL);
+        free(path);
+        path = absPath;
+    }
+
+    if (path != NULL && _programCacheSize < PROGRAM_CACHE_SIZE) {
+        _programCache[_programCacheSize].name = strdup(program);
+        _programCache[_programCacheSize].path = path;
+        _programCacheSize += 1;
+    }
+
+    return path;
+}
+
+// Not exported by libc, values from 'linux/ioprio.h'
+#define IOPRIO_WHO_PROCESS 1
+#define IOPRIO_CLASS_BE 2
+#define IOPRIO_CLASS_IDLE 3
+#define IOPRIO_VALUE(class, level) (((class) << 13) | (level))
+
+struct Job_Placement {
+    // One set per local slot, NULL when the slots aren't pinned
+    cpu_set_t* slotSets;
+    size_t slotCount;
+    // Every CPU the jobs may use, what's left after the reserved ones
+    cpu_set_t wideSet;
+    int nice;
+    int ioprio;
+    // Every job gets its own cgroup under '_jobCgroupRoot', 'memoryMax' is its 'memory.max' or 0 for none
+    bool isolate;
+    uint64_t memoryMax;
+};
+
+// '<our cgroup>/cbuilder', CBuilder moves itself to 'self' below it and every job gets a sibling
+static char _jobCgroupRoot[PATH_MAX];
+static int _jobCgroupState = 0; // 0 not tried yet, 1 ready, -1 unavailable
+static uint64_t _jobCgroupSeq = 0;
+
+static bool _WriteCgroupFile(char* dir, char* file, char* value)
+{
+    char path[PATH_MAX];
+    if (_PathJoin(path, dir, file) == NULL)
+        return false;
+
+    int fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd == -1)
+        return false;
+
+    size_t valueLen = StrLen(value);
+    bool ok = write(fd, value, valueLen) == (ssize_t) valueLen;
+    close(fd);
 
+    return ok;
+}
+
+static size_t _ReadCgroupFile(char* dir, char* file, char* buffer, size_t bufferSize)
+{
+    char path[PATH_MAX];
+    if (_PathJoin(path, dir, file) == NULL)
+        return 0;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return 0;
+
+    ssize_t size = read(fd, buffer, bufferSize - 1);
+    close(fd);
+    buffer[size > 0 ? size : 0] = '\0';
+
+    return size > 0 ? (size_t) size : 0;
+}
+
+// Sums the values of every '<key><number>', keys are 'name ' in flat files and 'name=' in nested ones like 'io.stat'
+static uint64_t _SumCgroupKey(char* data, const char* key)
+{
+    uint64_t sum = 0;
+    size_t keyLen = StrLen(key);
+    for (char* match = strstr(data, key); match != NULL; match = strstr(match + keyLen, key)) {
+        if (match == data || match[-1] == '\n' || match[-1] == ' ')
+            sum += strtoull(match + keyLen, NULL, 10);
+    }
+
+    return sum;
+}
+
+// Only works inside a delegated cgroup v2, like 'systemd-run --user -p Delegate=yes'. A cgroup that hands controllers
+// down can't hold processes itself, so CBuilder first moves out of the way into a leaf of its own.
+static bool _SetUpJobCgroups()
+{
+    if (_jobCgroupState != 0)
+        return _jobCgroupState == 1;
+    _jobCgroupState = -1;
+
+    char line[PATH_MAX];
+    char ownPath[PATH_MAX] = {0};
+    FILE* file = fopen("/proc/self/cgroup", "r");
+    if (file == NULL)
+        return false;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (strncmp(line, "0::/", 4) == 0) {
+            line[strcspn(line, "\n")] = '\0';
+            if (_PathJoin(ownPath, "/sys/fs/cgroup", &line[4]) == NULL)
+                ownPath[0] = '\0';
+        }
+    }
+    fclose(file);
+
+    // On a hybrid v1 hierarchy '/sys/fs/cgroup' isn't a cgroup at all
+    char selfDir[PATH_MAX];
+    if (ownPath[0] == '\0' || _PathJoin(selfDir, ownPath, "cgroup.controllers") == NULL || !IsFileValid(selfDir))
+        return false;
+    if (_PathJoin(_jobCgroupRoot, ownPath, "cbuilder") == NULL || _PathJoin(selfDir, _jobCgroupRoot, "self") == NULL)
+        return false;
+
+    // Padded, so ' cpu ' doesn't match 'cpuset'
+    char enabled[256] = " ";
+    _ReadCgroupFile(ownPath, "cgroup.subtree_control", &enabled[1], sizeof(enabled) - 2);
+    enabled[strcspn(enabled, "\n")] = '\0';
+    strcat(enabled, " ");
+
+    if ((mkdir(_jobCgroupRoot, 0755) != 0 && errno != EEXIST) || (mkdir(selfDir, 0755) != 0 && errno != EEXIST)) {
+        rmdir(_jobCgroupRoot);
+        return false;
+    }
+    if (!_WriteCgroupFile(selfDir, "cgroup.procs", "0")) {
+        rmdir(selfDir);
+        rmdir(_jobCgroupRoot);
+        return false;
+    }
+
+    // 'cpu' and 'io' only add accounting, without 'memory' there's no point. Only what wasn't on yet is turned off again.
+    char* controllers[] = { "cpu", "io", "memory" };
+    bool added[3] = {0};
+    bool ok = true;
+    for (size_t i = 0; i < 3; i += 1) {
+        char padded[16];
+        char change[16];
+        snprintf(padded, sizeof(padded), " %s ", controllers[i]);
+        snprintf(change, sizeof(change), "+%s", controllers[i]);
+        bool wasOn = strstr(enabled, padded) != NULL;
+        added[i] = !wasOn && _WriteCgroupFile(ownPath, "cgroup.subtree_control", change);
+        bool onBelow = (wasOn || added[i]) && _WriteCgroupFile(_jobCgroupRoot, "cgroup.subtree_control", change);
+        if (StrCmp(controllers[i], "memory"))
+            ok = onBelow;
+    }
+
+    // A cgroup with controllers on for its children takes no processes, so they go off before we move back,
+    // the children's first since a controller a child still hands down can't be turned off above it
+    if (!ok) {
+        for (size_t i = 0; i < 3; i += 1) {
+            char change[16];
+            snprintf(change, sizeof(change), "-%s", controllers[i]);
+            _WriteCgroupFile(_jobCgroupRoot, "cgroup.subtree_control", change);
+        }
+        for (size_t i = 0; i < 3; i += 1) {
+            char change[16];
+            snprintf(change, sizeof(change), "-%s", controllers[i]);
+            if (added[i])
+                _WriteCgroupFile(ownPath, "cgroup.subtree_control", change);
+        }
+        _WriteCgroupFile(ownPath, "cgroup.procs", "0");
+        rmdir(selfDir);
+        rmdir(_jobCgroupRoot);
+        return false;
+    }
+
+    _jobCgroupState = 1;
+
+    return true;
+}
+
+// Once the job is done its cgroup has the totals of everything it started, not just the process we waited for
+static void _ReadJobCgroupStats(char* dir, Process_Stats* stats)
+{
+    char data[4096];
+    if (_ReadCgroupFile(dir, "cpu.stat", data, sizeof(data)) > 0) {
+        stats->userTimeUs = _SumCgroupKey(data, "user_usec ");
+        stats->sysTimeUs = _SumCgroupKey(data, "system_usec ");
+    }
+    if (_ReadCgroupFile(dir, "memory.peak", data, sizeof(data)) > 0)
+        stats->maxRssKb = strtoull(data, NULL, 10) / 1024;
+    if (_ReadCgroupFile(dir, "memory.events", data, sizeof(data)) > 0)
+        stats->oomKilled = _SumCgroupKey(data, "oom_kill ") > 0;
+    if (_ReadCgroupFile(dir, "io.stat", data, sizeof(data)) > 0) {
+        stats->ioReadKb = _SumCgroupKey(data, "rbytes=") / 1024;
+        stats->ioWriteKb = _SumCgroupKey(data, "wbytes=") / 1024;
+    }
+}
+
+static int _GetCpuNode(int cpu)
+{
+    char dirPath[64];
+    snprintf(dirPath, sizeof(dirPath), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR* dir = opendir(dirPath);
+    if (dir == NULL)
+        return 0;
+
+    int node = 0;
+    struct dirent* entry = NULL;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+            node = atoi(&entry->d_name[4]);
             break;
         }
     }
+    closedir(dir);
+
+    return node;
+}
+
+// 'affinity' is 'none', 'core' (a CPU per slot) or 'node' (the CPUs of a NUMA node per slot, nodes taken in turns),
+// 'priority' is 'normal', 'low' or 'idle'. The last 'reservedCores' of the CPUs we may run on are left alone.
+// With 'isolate' every job runs in its own cgroup, limited to 'memoryMax' bytes unless it's 0.
+// '*placement' stays NULL when there's nothing to apply, '*cpuCount' is how many CPUs the jobs get.
+bool CreateJobPlacement(char* affinity, char* priority, size_t reservedCores, bool isolate, uint64_t memoryMax, size_t slotCount, Job_Placement** placement, size_t* cpuCount)
+{
+    *placement = NULL;
+    *cpuCount = GetThreadCount();
+
+    bool pinCores = StrCmp(affinity, "core");
+    bool pinNodes = StrCmp(affinity, "node");
+    if (!pinCores && !pinNodes && !StrCmp(affinity, "none")) {
+        fprintf(stderr, "Invalid 'jobAffinity = %s', expected 'core', 'node' or 'none'\n", affinity);
+        return false;
+    }
+
+    int nice = 0;
+    int ioprio = 0;
+    if (StrCmp(priority, "low")) {
+        nice = 10;
+        ioprio = IOPRIO_VALUE(IOPRIO_CLASS_BE, 7);
+    } else if (StrCmp(priority, "idle")) {
+        nice = 19;
+        ioprio = IOPRIO_VALUE(IOPRIO_CLASS_IDLE, 0);
+    } else if (!StrCmp(priority, "normal")) {
+        fprintf(stderr, "Invalid 'jobPriority = %s', expected 'normal', 'low' or 'idle'\n", priority);
+        return false;
+    }
+
+    bool cgroupsTried = _jobCgroupState != 0;
+    if (isolate && !_SetUpJobCgroups()) {
+        if (!cgroupsTried)
+            fprintf(stderr, "Warning: not running in a delegated cgroup v2, jobs run without their own limits\n");
+        isolate = false;
+    }
+
+    if (!pinCores && !pinNodes && nice == 0 && reservedCores == 0 && !isolate)
+        return true;
+
+    // Starts from our own mask, so 'taskset' and cpusets still hold
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &allowed) != 0)
+        return false;
+
+    int cpus[CPU_SETSIZE];
+    size_t count = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu += 1) {
+        if (CPU_ISSET(cpu, &allowed)) {
+            cpus[count] = cpu;
+            count += 1;
+        }
+    }
+    if (reservedCores >= count) {
+        fprintf(stderr, "Reserving %zu of %zu cores leaves none for the build\n", reservedCores, count);
+        return false;
+    }
+    count -= reservedCores;
+
+    Job_Placement* result = (Job_Placement*) calloc(1, sizeof(Job_Placement));
+    result->nice = nice;
+    result->ioprio = ioprio;
+    result->isolate = isolate;
+    result->memoryMax = memoryMax;
+    CPU_ZERO(&result->wideSet);
+    for (size_t i = 0; i < count; i += 1)
+        CPU_SET(cpus[i], &result->wideSet);
+
+    if (pinCores || pinNodes) {
+        result->slotSets = (cpu_set_t*) calloc(slotCount, sizeof(cpu_set_t));
+        result->slotCount = slotCount;
+
+        int cpuNodes[CPU_SETSIZE];
+        int nodes[CPU_SETSIZE];
+        size_t nodeCount = 0;
+        for (size_t i = 0; i < count && pinNodes; i += 1) {
+            cpuNodes[i] = _GetCpuNode(cpus[i]);
+            bool known = false;
+            for (size_t j = 0; j < nodeCount && !known; j += 1)
+                known = nodes[j] == cpuNodes[i];
+            if (!known) {
+                nodes[nodeCount] = cpuNodes[i];
+                nodeCount += 1;
+            }
+        }
+
+        for (size_t slot = 0; slot < slotCount; slot += 1) {
+            cpu_set_t* set = &result->slotSets[slot];
+            CPU_ZERO(set);
+            if (pinCores) {
+                CPU_SET(cpus[slot % count], set);
+                continue;
+            }
+
+            int node = nodes[slot % nodeCount];
+            for (size_t i = 0; i < count; i += 1) {
+                if (cpuNodes[i] == node)
+                    CPU_SET(cpus[i], set);
+            }
+        }
+    }
 
-    char* currDir = (char*) malloc(PATH_MAX);
-    currDir = getcwd(currDir, PATH_MAX);
+    *placement = result;
+    *cpuCount = count;
 
-    // Since the child process inherits the CWD, we need to chage it temporarily
-    chdir(workDir);
-    int res = posix_spawnp(&process->pid, program, NULL, NULL, process->argv, environ);
-    chdir(currDir);
+    return true;
+}
 
-    free(currDir);
-    free(program);
+void DestroyJobPlacement(Job_Placement* placement)
+{
+    if (placement == NULL)
+        return;
 
-    return res == 0;
+    free(placement->slotSets);
+    free(placement);
 }
 
-void DestroyProcess(Process_Data* process)
+// Runs in the child between 'vfork()' and 'execve()', so the compiler allocates its memory on the right node
+// and everything it starts is accounted to its cgroup
+static void _ApplyJobPlacement(Job_Placement* placement, size_t slot, int cgroupFd)
+{
+    if (cgroupFd != -1)
+        write(cgroupFd, "0", 1);
+
+    bool pinned = placement->slotSets != NULL && slot < placement->slotCount;
+    sched_setaffinity(0, sizeof(cpu_set_t), pinned ? &placement->slotSets[slot] : &placement->wideSet);
+    if (placement->nice != 0)
+        setpriority(PRIO_PROCESS, 0, placement->nice);
+    if (placement->ioprio != 0)
+        syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, placement->ioprio);
+}
+
+// A fresh cgroup per job, so its stats only cover that job. Returns its 'cgroup.procs' or -1.
+static int _CreateJobCgroup(Job_Placement* placement, size_t slot, Process_Data* process)
+{
+    char name[64];
+    char dir[PATH_MAX];
+    snprintf(name, sizeof(name), "job-%d-%llu", (int) getpid(), (unsigned long long) _jobCgroupSeq);
+    _jobCgroupSeq += 1;
+    if (_PathJoin(dir, _jobCgroupRoot, name) == NULL || mkdir(dir, 0755) != 0)
+        return -1;
+
+    if (placement->memoryMax > 0 && slot != PLACEMENT_ALONE) {
+        char limit[32];
+        snprintf(limit, sizeof(limit), "%llu", (unsigned long long) placement->memoryMax);
+        _WriteCgroupFile(dir, "memory.max", limit);
+        // Swapping would only hide that the job went past its limit
+        _WriteCgroupFile(dir, "memory.swap.max", "0");
+    }
+
+    char procsPath[PATH_MAX];
+    int fd = (_PathJoin(procsPath, dir, "cgroup.procs") != NULL) ? open(procsPath, O_WRONLY | O_CLOEXEC) : -1;
+    if (fd == -1) {
+        rmdir(dir);
+        return -1;
+    }
+
+    process->cgroupDir = strdup(dir);
+
+    return fd;
+}
+
+// 'placement' may be NULL, past its slots or without pinned ones a job may use every allowed CPU.
+// 'PLACEMENT_ALONE' also lifts the job's memory limit.
+bool SpawnAsyncProcess(char* cmd, char* workDir, char* outputPath, Job_Placement* placement, size_t slot, Process_Data* process)
 {
-    for (size_t i = 0; process->argv[i] != NULL; i += 1)
-        free(process->argv[i]);
+    MemZero(process, sizeof(Process_Data));
+    process->argv = _SplitCmdArgs(&process->argArena, &process->args, cmd);
+    char* program = (process->argv[0] != NULL) ? ResolveProgramPath(process->argv[0]) : NULL;
+    if (program == NULL) {
+        DestroyArena(&process->argArena);
+        return false;
+    }
+
+    int cgroupFd = (placement != NULL && placement->isolate) ? _CreateJobCgroup(placement, slot, process) : -1;
+
+    // 'vfork()' doesn't copy the page tables and the child shares our memory until 'execve()',
+    // so it can report a failure by writing to 'childErr'. Only the child changes its working dir.
+    volatile int childErr = 0;
+    pid_t pid = vfork();
+    if (pid == 0) {
+        if (placement != NULL)
+            _ApplyJobPlacement(placement, slot, cgroupFd);
+        // An empty work dir means the current one
+        bool stayInCwd = workDir == NULL || workDir[0] == '\0';
+        if (stayInCwd || chdir(workDir) == 0) {
+            // Opened after the 'chdir()', so a relative output path is relative to the work dir
+            int outputFd = (outputPath != NULL) ? open(outputPath, O_WRONLY | O_CREAT | O_TRUNC, 0644) : STDOUT_FILENO;
+            if (outputFd != -1 && (outputFd == STDOUT_FILENO || dup2(outputFd, STDOUT_FILENO) != -1))
+                execve(program, process->argv, environ);
+        }
+
+        childErr = errno;
+        _exit(127);
+    }
+
+    if (cgroupFd != -1)
+        close(cgroupFd);
 
-    free(process->argv);
+    if (pid == -1 || childErr != 0) {
+        if (pid != -1)
+            waitpid(pid, NULL, 0);
+        DestroyProcess(process);
+        return false;
+    }
+
+    process->pid = pid;
+
+    return true;
+}
+
+void DestroyProcess(Process_Data* process)
+{
+    DestroyArena(&process->argArena);
+    MemZero(&process->args, sizeof(Str_List));
     process->argv = NULL;
     process->pid  = 0;
+
+    // Empty once its processes are gone, removing it is all the cleanup a cgroup needs
+    if (process->cgroupDir != NULL) {
+        rmdir(process->cgroupDir);
+        free(process->cgroupDir);
+        process->cgroupDir = NULL;
+    }
 }
 
 bool WaitForMultipleProcesses(Process_Data* processList, size_t processCount)
@@ -193,7 +728,238 @@ bool WaitForMultipleProcesses(Process_Data* processList, size_t processCount)
     return true;
 }
 
+static void _FillProcessStats(struct rusage* usage, Process_Stats* stats)
+{
+    stats->userTimeUs = (uint64_t) usage->ru_utime.tv_sec * 1000000ull + (uint64_t) usage->ru_utime.tv_usec;
+    stats->sysTimeUs  = (uint64_t) usage->ru_stime.tv_sec * 1000000ull + (uint64_t) usage->ru_stime.tv_usec;
+    stats->maxRssKb   = (uint64_t) usage->ru_maxrss;
+    stats->ioReadKb   = (uint64_t) usage->ru_inblock / 2;
+    stats->ioWriteKb  = (uint64_t) usage->ru_oublock / 2;
+    stats->oomKilled  = false;
+}
+
+size_t WaitForAnyProcess(Process_Data* processList, size_t processCount, Process_Stats* stats)
+{
+    while (true) {
+        int status = 0;
+        struct rusage usage = {0};
+        pid_t pid = wait4(-1, &status, 0, &usage);
+        if (pid == -1)
+            return processCount;
+
+        for (size_t i = 0; i < processCount; i += 1) {
+            if (processList[i].pid == pid) {
+                _FillProcessStats(&usage, stats);
+                stats->exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+                if (processList[i].cgroupDir != NULL)
+                    _ReadJobCgroupStats(processList[i].cgroupDir, stats);
+                DestroyProcess(&processList[i]);
+
+                return i;
+            }
+        }
+    }
+}
+
+void GetSelfStats(Process_Stats* stats)
+{
+    struct rusage usage = {0};
+    getrusage(RUSAGE_SELF, &usage);
+    _FillProcessStats(&usage, stats);
+    stats->exitCode = 0;
+}
+
+uint64_t GetTimeUs()
+{
+    struct timespec ts = {0};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000ull + (uint64_t) ts.tv_nsec / 1000ull;
+}
+
 size_t GetThreadCount()
 {
     return (size_t) get_nprocs();
 }
+
+uint64_t GetSystemTimeNs()
+{
+    struct timespec ts = {0};
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+char* GetLtoFlags(Arena* arena, char* compiler, char* linkFlags, char* ltoJobs, size_t freeSlots, char* ltoPartition, char* ltoCache)
+{
+    if (strstr(linkFlags, "-flto") == NULL)
+        return NULL;
+
+    bool isClang = strstr(compiler, "clang") != NULL;
+    bool useLld = strstr(linkFlags, "-fuse-ld=lld") != NULL;
+
+    char jobsFlag[64] = {0};
+    if (StrCmp(ltoJobs, "jobserver") && !isClang) {
+        // GCC can only join a jobserver that was handed down to us by make
+        char* makeFlags = getenv("MAKEFLAGS");
+        if (makeFlags != NULL && strstr(makeFlags, "--jobserver-") != NULL) {
+            snprintf(jobsFlag, sizeof(jobsFlag), "-flto=jobserver");
+        } else {
+            fprintf(stderr, "No jobserver available, using %zu LTO jobs\n", freeSlots);
+            ltoJobs = "auto";
+        }
+    }
+
+    if (jobsFlag[0] == '\0') {
+        size_t jobs = freeSlots;
+        if (!StrCmp(ltoJobs, "auto") && !StrCmp(ltoJobs, "jobserver"))
+            jobs = (size_t) strtoull(ltoJobs, NULL, 10);
+        if (jobs == 0)
+            jobs = 1;
+
+        snprintf(jobsFlag, sizeof(jobsFlag), isClang ? "-flto-jobs=%zu" : "-flto=%zu", jobs);
+    }
+
+    char partitionFlag[64] = {0};
+    if (ltoPartition != NULL && !isClang)
+        snprintf(partitionFlag, sizeof(partitionFlag), "-flto-partition=%s", ltoPartition);
+
+    char* cacheFlag = NULL;
+    if (ltoCache != NULL && isClang) {
+        const char* cacheFmt = useLld ? "-Wl,--thinlto-cache-dir=%s" : "-Wl,-plugin-opt,cache-dir=%s";
+        size_t cacheFlagLen = 1 + snprintf(NULL, 0, cacheFmt, ltoCache);
+        cacheFlag = (char*) ArenaAlloc(arena, cacheFlagLen);
+        snprintf(cacheFlag, cacheFlagLen, cacheFmt, ltoCache);
+    }
+
+    const char* flagsFmt = "%s %s %s";
+    char* cacheStr = cacheFlag != NULL ? cacheFlag : "";
+    size_t flagsLen = 1 + snprintf(NULL, 0, flagsFmt, jobsFlag, partitionFlag, cacheStr);
+    char* flags = (char*) ArenaAlloc(arena, flagsLen);
+    snprintf(flags, flagsLen, flagsFmt, jobsFlag, partitionFlag, cacheStr);
+
+    return flags;
+}
+
+typedef struct Linker_Info {
+    const char* name;
+    const char* program;
+    const char* threadsFmt;
+} Linker_Info;
+
+// In the order 'auto' tries them, only the fast ones are worth picking over the default
+static const Linker_Info _linkers[] = {
+    { "mold", "mold", "-Wl,--threads=%zu" },
+    { "lld", "ld.lld", "-Wl,--threads=%zu" },
+    { "gold", "ld.gold", "-Wl,--threads,--thread-count=%zu" },
+    { "bfd", "ld.bfd", "" },
+};
+#define LINKER_AUTO_COUNT 2
+
+// The driver keeps running the link, '-fuse-ld' only changes the linker behind it. A '-fuse-ld' already in
+// 'linkFlags' wins and 'default' leaves the driver's own choice alone. 'auto' never takes lld for GCC's LTO,
+// lld only loads LLVM's plugin and can't read GIMPLE objects. gold's '--incremental' rules out PIE, RELRO and the LTO plugin and still crashes on relinks,
+// so links are always full ones, mold and lld are the fast path instead.
+char* GetLinkerFlags(Arena* arena, char* compiler, char* linker, char* linkFlags, size_t threads, bool incremental, char** program)
+{
+    *program = NULL;
+    if (strstr(linkFlags, "-fuse-ld=") != NULL)
+        return NULL;
+
+    bool gccLto = strstr(linkFlags, "-flto") != NULL && strstr(compiler, "clang") == NULL;
+    const Linker_Info* chosen = NULL;
+    if (StrCmp(linker, "auto")) {
+        for (size_t i = 0; i < LINKER_AUTO_COUNT && chosen == NULL; i += 1) {
+            bool usable = !gccLto || !StrCmp(_linkers[i].name, "lld");
+            if (usable && ResolveProgramPath((char*) _linkers[i].program) != NULL)
+                chosen = &_linkers[i];
+        }
+    } else if (!StrCmp(linker, "default")) {
+        for (size_t i = 0; i < sizeof(_linkers) / sizeof(_linkers[0]) && chosen == NULL; i += 1) {
+            if (StrCmp(linker, _linkers[i].name))
+                chosen = &_linkers[i];
+        }
+
+        if (chosen == NULL) {
+            fprintf(stderr, "Warning: unknown linker '%s', using the default one\n", linker);
+        } else if (ResolveProgramPath((char*) chosen->program) == NULL) {
+            fprintf(stderr, "Warning: linker '%s' not found, using the default one\n", linker);
+            chosen = NULL;
+        }
+    }
+
+    if (incremental)
+        fprintf(stderr, "Warning: no Linux linker relinks incrementally, doing full links\n");
+    if (chosen == NULL)
+        return NULL;
+
+    char threadsFlag[64] = {0};
+    snprintf(threadsFlag, sizeof(threadsFlag), chosen->threadsFmt, threads > 0 ? threads : 1);
+
+    const char* flagsFmt = "-fuse-ld=%s %s";
+    size_t flagsLen = 1 + snprintf(NULL, 0, flagsFmt, chosen->name, threadsFlag);
+    char* flags = (char*) ArenaAlloc(arena, flagsLen);
+    snprintf(flags, flagsLen, flagsFmt, chosen->name, threadsFlag);
+
+    return flags;
+}
+
+bool GetCacheDirStats(char* path, uint64_t since, size_t* entries, size_t* touched)
+{
+    DIR* dir = opendir(path);
+    if (dir == NULL)
+        return false;
+
+    *entries = 0;
+    *touched = 0;
+
+    struct dirent* entry = NULL;
+    while ((entry = readdir(dir))) {
+        if (entry->d_type == DT_DIR)
+            continue;
+
+        char filePath[PATH_MAX];
+        struct stat fileInfo = {0};
+        if (_PathJoin(filePath, path, entry->d_name) != NULL && stat(filePath, &fileInfo) == 0) {
+            uint64_t mtime = (uint64_t) fileInfo.st_mtim.tv_sec * 1000000000ull + (uint64_t) fileInfo.st_mtim.tv_nsec;
+            *entries += 1;
+            if (mtime >= since)
+                *touched += 1;
+        }
+    }
+
+    closedir(dir);
+
+    return true;
+}
+
+// Runs 'cmd' through the shell, stdout and whatever it redirects into it. NULL when it can't run or fails.
+char* CaptureProcessOutput(char* cmd, size_t* size)
+{
+    FILE* pipe = popen(cmd, "r");
+    if (pipe == NULL)
+        return NULL;
+
+    size_t used = 0;
+    size_t capacity = 64 * 1024;
+    char* output = (char*) malloc(capacity);
+    while (true) {
+        if (used == capacity) {
+            capacity *= 2;
+            output = (char*) realloc(output, capacity);
+        }
+
+        size_t readSize = fread(&output[used], 1, capacity - used, pipe);
+        if (readSize == 0)
+            break;
+        used += readSize;
+    }
+
+    if (pclose(pipe) != 0) {
+        free(output);
+        return NULL;
+    }
+
+    *size = used;
+    return output;
+}
@@ -1,6 +1,7 @@
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 #include <shlwapi.h>
+#include <psapi.h>
 
 #if defined(StrLen) || defined(StrCpy) || defined(StrCmp)
 	// HACK: There are a ton of Str macros defined in 'shlwapi.h'
@@ -23,92 +24,416 @@ bool IsDirValid(char* dir)
 	return PathIsDirectoryA(dir);
 }
 
+bool GetFileModTime(char* path, uint64_t* mtimeNs)
+{
+	WIN32_FILE_ATTRIBUTE_DATA fileInfo = {0};
+	if (!GetFileAttributesExA(path, GetFileExInfoStandard, &fileInfo))
+		return false;
+
+	// 100ns intervals since 1601, only ever compared with each other
+	uint64_t ticks = ((uint64_t) fileInfo.ftLastWriteTime.dwHighDateTime << 32) | fileInfo.ftLastWriteTime.dwLowDateTime;
+	*mtimeNs = ticks * 100;
+	return true;
+}
+
+bool GetFileIdentity(char* path, File_Identity* identity)
+{
+	HANDLE file = CreateFileA(path, 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	BY_HANDLE_FILE_INFORMATION fileInfo = {0};
+	BOOL ok = GetFileInformationByHandle(file, &fileInfo);
+	CloseHandle(file);
+	if (!ok)
+		return false;
+
+	uint64_t ticks = ((uint64_t) fileInfo.ftLastWriteTime.dwHighDateTime << 32) | fileInfo.ftLastWriteTime.dwLowDateTime;
+	identity->id = (((uint64_t) fileInfo.nFileIndexHigh << 32) | fileInfo.nFileIndexLow) ^ fileInfo.dwVolumeSerialNumber;
+	identity->mtimeNs = ticks * 100;
+	identity->size = ((uint64_t) fileInfo.nFileSizeHigh << 32) | fileInfo.nFileSizeLow;
+	return true;
+}
+
+bool CreateDirRecursive(char* path)
+{
+	char dir[MAX_PATH + 1];
+	size_t pathLen = StrLen(path);
+	if (pathLen > MAX_PATH)
+		return false;
+	MemCpy(dir, path, pathLen + 1);
+
+	for (size_t i = 1; i <= pathLen; i += 1) {
+		if (dir[i] != '/' && dir[i] != '\\' && dir[i] != '\0')
+			continue;
+		// Drive roots like 'C:' can't be created
+		if (dir[i - 1] == ':')
+			continue;
+
+		char c = dir[i];
+		dir[i] = '\0';
+		if (!CreateDirectoryA(dir, NULL) && GetLastError() != ERROR_ALREADY_EXISTS)
+			return false;
+		dir[i] = c;
+	}
+
+	return true;
+}
+
+bool MapFile(char* path, Mapped_File* file)
+{
+	HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (handle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize = {0};
+	GetFileSizeEx(handle, &fileSize);
+	file->size = (size_t) fileSize.QuadPart;
+	file->mapped = false;
+
+	// A copy-on-write view can be modified in place. The bytes past the end of the file up to the page
+	// boundary are zero, that's where the terminator comes from, so full pages can't be mapped.
+	SYSTEM_INFO info = {0};
+	GetSystemInfo(&info);
+	if (file->size > 0 && file->size % info.dwPageSize != 0) {
+		HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+		if (mapping != NULL) {
+			void* data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+			// The view keeps the mapping alive
+			CloseHandle(mapping);
+			if (data != NULL) {
+				file->data = (char*) data;
+				file->mapped = true;
+				CloseHandle(handle);
+
+				return true;
+			}
+		}
+	}
+
+	file->data = (char*) malloc(file->size + 1);
+	DWORD bytesRead = 0;
+	ReadFile(handle, file->data, (DWORD) file->size, &bytesRead, NULL);
+	file->data[bytesRead] = '\0';
+	CloseHandle(handle);
+
+	return true;
+}
+
+void UnmapFile(Mapped_File* file)
+{
+	if (file->mapped)
+		UnmapViewOfFile(file->data);
+	else
+		free(file->data);
+
+	file->data = NULL;
+	file->size = 0;
+}
+
 // Forward declaration
 char* GetFilenameFromPath(char* path);
-char* GetDirFromPath(char* path);
+char* GetDirFromPath(Arena* arena, char* path);
 char* GetFileExtension(char* file);
-size_t FullLenStrList(Str_List list);
 
-size_t IterateDir(size_t startIndex, bool recurse, char** fileList, char* path, char* ext)
+size_t IterateDir(Arena* arena, bool recurse, Str_List* fileList, char* path, char* ext)
 {
 	const char* idk = "*";
-	char* findPath = (char*) malloc(StrLen(path) + 2);
-	findPath = PathCombineA(findPath, path, idk);
+	char findPath[MAX_PATH];
+	PathCombineA(findPath, path, idk);
 
-	size_t entryIndex = startIndex;
+	size_t entryCount = 0;
 	WIN32_FIND_DATAA fileData = {};
 	HANDLE find = FindFirstFileA(findPath, &fileData);
 	do {
 		if (fileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
 			// We want to skip the '.' and '..' directories
 			if (recurse && !StrCmp(fileData.cFileName, ".") && !StrCmp(fileData.cFileName, "..")) {
-				char* subDir = (char*) malloc(MAX_PATH + 1);
-				subDir = PathCombineA(subDir, path, fileData.cFileName);
-				entryIndex = IterateDir(entryIndex, recurse, fileList, subDir, ext);
-				free(subDir);
+				char subDir[MAX_PATH];
+				if (PathCombineA(subDir, path, fileData.cFileName) != NULL)
+					entryCount += IterateDir(arena, recurse, fileList, subDir, ext);
 			}
 
 			continue;
 		}
 
 		char* currExt = GetFileExtension(fileData.cFileName);
-		if (StrCmp(currExt, ext)) {
-			if (fileList != NULL) {
-				fileList[entryIndex] = (char*) malloc(MAX_PATH + 1);
-				fileList[entryIndex] = PathCombineA(fileList[entryIndex], path, fileData.cFileName);
-			}
-
-			entryIndex += 1;
+		if (currExt != NULL && ext != NULL && StrCmp(currExt, ext)) {
+			char filePath[MAX_PATH];
+			PathCombineA(filePath, path, fileData.cFileName);
+			PushStrList(arena, fileList, filePath, StrLen(filePath));
+			entryCount += 1;
 		}
-
-		free(currExt);
 	} while (FindNextFileA(find, &fileData));
 
 	FindClose(find);
-	free(findPath);
 
-	return entryIndex;
+	return entryCount;
 }
 
-char* GetLibsStr(Str_List libs)
+char* GetFullPath(Arena* arena, char* path)
 {
-	char* libsStr = (char*) malloc(FullLenStrList(libs));
-	size_t libsStrOffset = 0;
-	for (size_t i = 0; i < libs.size; i += 1) {
-		size_t strLen = StrLen(libs.data[i]);
-		MemCpy(&libsStr[libsStrOffset], libs.data[i], strLen + 1);
-		if (i < libs.size - 1)
-			libsStr[libsStrOffset + strLen] = ' ';
+	char fullPath[MAX_PATH + 1];
+	DWORD pathLen = GetFullPathNameA(path, MAX_PATH, fullPath, NULL);
+	if (pathLen == 0 || pathLen > MAX_PATH)
+		return NULL;
 
-		libsStrOffset += strLen + 1;
-	}
+	return ArenaStrDup(arena, fullPath, pathLen);
+}
+
+char* GetExecutablePath(Arena* arena)
+{
+	char path[MAX_PATH + 1];
+	DWORD pathLen = GetModuleFileNameA(NULL, path, MAX_PATH);
+	if (pathLen == 0 || pathLen >= MAX_PATH)
+		return NULL;
 
-	return libsStr;
+	return ArenaStrDup(arena, path, pathLen);
 }
 
 typedef struct Process_Data {
 	STARTUPINFO startInfo; // TODO: Probably doesn't need to live here
 	PROCESS_INFORMATION processInfo;
+	// The job's own Job Object, NULL when it isn't isolated, and the memory limit it got or 0
+	HANDLE jobObject;
+	uint64_t memoryMax;
 } Process_Data;
 
-bool SpawnAsyncProcess(char* cmd, char* workDir, Process_Data* process)
+typedef struct Program_Path {
+	char* name;
+	char* path;
+} Program_Path;
+
+#define PROGRAM_CACHE_SIZE 16
+static Program_Path _programCache[PROGRAM_CACHE_SIZE];
+static size_t _programCacheSize = 0;
+
+// Searches 'PATH' only the first time a program is seen, every spawn after that reuses the result
+char* ResolveProgramPath(char* program)
 {
+	for (size_t i = 0; i < _programCacheSize; i += 1)
+		if (StrCmp(_programCache[i].name, program))
+			return _programCache[i].path;
+
+	char* path = (char*) malloc(MAX_PATH + 1);
+	DWORD pathLen = SearchPathA(NULL, program, ".exe", MAX_PATH, path, NULL);
+	if (pathLen == 0 || pathLen > MAX_PATH) {
+		free(path);
+		return NULL;
+	}
+
+	if (_programCacheSize < PROGRAM_CACHE_SIZE) {
+		_programCache[_programCacheSize].name = _strdup(program);
+		_programCache[_programCacheSize].path = path;
+		_programCacheSize += 1;
+	}
+
+	return path;
+}
+
+struct Job_Placement {
+	// One mask per local slot, NULL when the slots aren't pinned
+	DWORD_PTR* slotMasks;
+	size_t slotCount;
+	// Every CPU the jobs may use, what's left after the reserved ones
+	DWORD_PTR wideMask;
+	DWORD priorityClass;
+	// Every job gets its own Job Object, 'memoryMax' is its job memory limit or 0 for none
+	bool isolate;
+	uint64_t memoryMax;
+};
+
+// 'affinity' is 'none', 'core' (a CPU per slot) or 'node' (the CPUs of a NUMA node per slot, nodes taken in turns),
+// 'priority' is 'normal', 'low' or 'idle'. The last 'reservedCores' of the CPUs we may run on are left alone.
+// With 'isolate' every job runs in its own Job Object, limited to 'memoryMax' bytes unless it's 0.
+// Only the processor group we run in is used. '*placement' stays NULL when there's nothing to apply.
+bool CreateJobPlacement(char* affinity, char* priority, size_t reservedCores, bool isolate, uint64_t memoryMax, size_t slotCount, Job_Placement** placement, size_t* cpuCount)
+{
+	*placement = NULL;
+	*cpuCount = GetThreadCount();
+
+	bool pinCores = StrCmp(affinity, "core");
+	bool pinNodes = StrCmp(affinity, "node");
+	if (!pinCores && !pinNodes && !StrCmp(affinity, "none")) {
+		fprintf(stderr, "Invalid 'jobAffinity = %s', expected 'core', 'node' or 'none'\n", affinity);
+		return false;
+	}
+
+	DWORD priorityClass = NORMAL_PRIORITY_CLASS;
+	if (StrCmp(priority, "low")) {
+		priorityClass = BELOW_NORMAL_PRIORITY_CLASS;
+	} else if (StrCmp(priority, "idle")) {
+		priorityClass = IDLE_PRIORITY_CLASS;
+	} else if (!StrCmp(priority, "normal")) {
+		fprintf(stderr, "Invalid 'jobPriority = %s', expected 'normal', 'low' or 'idle'\n", priority);
+		return false;
+	}
+
+	if (!pinCores && !pinNodes && priorityClass == NORMAL_PRIORITY_CLASS && reservedCores == 0 && !isolate)
+		return true;
+
+	DWORD_PTR processMask = 0;
+	DWORD_PTR systemMask = 0;
+	if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+		return false;
+
+	UCHAR cpus[sizeof(DWORD_PTR) * 8];
+	size_t count = 0;
+	for (UCHAR cpu = 0; cpu < sizeof(DWORD_PTR) * 8; cpu += 1) {
+		if (processMask & ((DWORD_PTR) 1 << cpu)) {
+			cpus[count] = cpu;
+			count += 1;
+		}
+	}
+	if (reservedCores >= count) {
+		fprintf(stderr, "Reserving %zu of %zu cores leaves none for the build\n", reservedCores, count);
+		return false;
+	}
+	count -= reservedCores;
+
+	Job_Placement* result = (Job_Placement*) calloc(1, sizeof(Job_Placement));
+	result->priorityClass = priorityClass;
+	result->isolate = isolate;
+	result->memoryMax = memoryMax;
+	for (size_t i = 0; i < count; i += 1)
+		result->wideMask |= (DWORD_PTR) 1 << cpus[i];
+
+	if (pinCores || pinNodes) {
+		result->slotMasks = (DWORD_PTR*) calloc(slotCount, sizeof(DWORD_PTR));
+		result->slotCount = slotCount;
+
+		UCHAR cpuNodes[sizeof(DWORD_PTR) * 8];
+		UCHAR nodes[sizeof(DWORD_PTR) * 8];
+		size_t nodeCount = 0;
+		for (size_t i = 0; i < count && pinNodes; i += 1) {
+			if (!GetNumaProcessorNode(cpus[i], &cpuNodes[i]) || cpuNodes[i] == 0xFF)
+				cpuNodes[i] = 0;
+			bool known = false;
+			for (size_t j = 0; j < nodeCount && !known; j += 1)
+				known = nodes[j] == cpuNodes[i];
+			if (!known) {
+				nodes[nodeCount] = cpuNodes[i];
+				nodeCount += 1;
+			}
+		}
+
+		for (size_t slot = 0; slot < slotCount; slot += 1) {
+			if (pinCores) {
+				result->slotMasks[slot] = (DWORD_PTR) 1 << cpus[slot % count];
+				continue;
+			}
+
+			UCHAR node = nodes[slot % nodeCount];
+			for (size_t i = 0; i < count; i += 1) {
+				if (cpuNodes[i] == node)
+					result->slotMasks[slot] |= (DWORD_PTR) 1 << cpus[i];
+			}
+		}
+	}
+
+	*placement = result;
+	*cpuCount = count;
+
+	return true;
+}
+
+void DestroyJobPlacement(Job_Placement* placement)
+{
+	if (placement == NULL)
+		return;
+
+	free(placement->slotMasks);
+	free(placement);
+}
+
+// Nested Job Objects need Windows 8, an older one refuses to assign a process that's already in a job
+static HANDLE _CreateJobObject(Job_Placement* placement, size_t slot, uint64_t* memoryMax)
+{
+	HANDLE jobObject = CreateJobObjectA(NULL, NULL);
+	if (jobObject == NULL)
+		return NULL;
+
+	*memoryMax = (slot != PLACEMENT_ALONE) ? placement->memoryMax : 0;
+	if (*memoryMax > 0) {
+		JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits = {0};
+		limits.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_JOB_MEMORY;
+		limits.JobMemoryLimit = (SIZE_T) *memoryMax;
+		SetInformationJobObject(jobObject, JobObjectExtendedLimitInformation, &limits, sizeof(limits));
+	}
+
+	return jobObject;
+}
+
+// 'placement' may be NULL, past its slots or without pinned ones a job may use every allowed CPU.
+// 'PLACEMENT_ALONE' also lifts the job's memory limit.
+bool SpawnAsyncProcess(char* cmd, char* workDir, char* outputPath, Job_Placement* placement, size_t slot, Process_Data* process)
+{
+	// The program is the first argument, it may be quoted
+	char program[MAX_PATH + 1] = {0};
+	size_t programStart = (cmd[0] == '\"') ? 1 : 0;
+	size_t programLen = 0;
+	char programEnd = (cmd[0] == '\"') ? '\"' : ' ';
+	while (cmd[programStart + programLen] != '\0' && cmd[programStart + programLen] != programEnd && programLen < MAX_PATH)
+		programLen += 1;
+	MemCpy(program, &cmd[programStart], programLen);
+
+	char* programPath = ResolveProgramPath(program);
+	if (programPath == NULL)
+		return false;
+
 	char* workDirAbs = (char*) malloc(MAX_PATH + 1);
 	GetFullPathNameA(workDir, MAX_PATH, workDirAbs, NULL);
 
+	// A placed process starts suspended, so it never runs a single instruction on the wrong CPUs
+	DWORD creationFlags = (placement != NULL) ? (placement->priorityClass | CREATE_SUSPENDED) : NORMAL_PRIORITY_CLASS;
+
 	MemZero(process, sizeof(Process_Data));
+	process->startInfo.cb = sizeof(process->startInfo);
+
+	// Only the output file is inheritable, the child gets our stdin and stderr along with it
+	HANDLE output = INVALID_HANDLE_VALUE;
+	if (outputPath != NULL) {
+		char outputAbs[MAX_PATH];
+		SECURITY_ATTRIBUTES inheritable = { sizeof(SECURITY_ATTRIBUTES), NULL, TRUE };
+		if (PathCombineA(outputAbs, workDirAbs, outputPath) != NULL)
+			output = CreateFileA(outputAbs, GENERIC_WRITE, FILE_SHARE_READ, &inheritable, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (output == INVALID_HANDLE_VALUE) {
+			free(workDirAbs);
+			return false;
+		}
+
+		process->startInfo.dwFlags |= STARTF_USESTDHANDLES;
+		process->startInfo.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+		process->startInfo.hStdOutput = output;
+		process->startInfo.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+	}
+
 	BOOL res = CreateProcessA(
-		NULL, cmd,
+		programPath, cmd,
 		NULL, NULL,
-		// TODO: Maybe 'bInheritHandles' should be true in order to share StdOutput
-		FALSE, NORMAL_PRIORITY_CLASS,
+		output != INVALID_HANDLE_VALUE, creationFlags,
 		NULL, workDirAbs,
 		&process->startInfo, &process->processInfo
 	);
 
-	// TODO: Idk if that's safe
+	if (output != INVALID_HANDLE_VALUE)
+		CloseHandle(output);
 	free(workDirAbs);
 
+	if (res == TRUE && placement != NULL) {
+		bool pinned = placement->slotMasks != NULL && slot < placement->slotCount;
+		SetProcessAffinityMask(process->processInfo.hProcess, pinned ? placement->slotMasks[slot] : placement->wideMask);
+		// Assigned while it's suspended, so whatever it starts is in the job too
+		if (placement->isolate) {
+			process->jobObject = _CreateJobObject(placement, slot, &process->memoryMax);
+			if (process->jobObject != NULL && !AssignProcessToJobObject(process->jobObject, process->processInfo.hProcess)) {
+				CloseHandle(process->jobObject);
+				process->jobObject = NULL;
+			}
+		}
+		ResumeThread(process->processInfo.hThread);
+	}
+
 	return res == TRUE;
 }
 
@@ -127,6 +452,101 @@ bool WaitForMultipleProcesses(Process_Data* processList, size_t processCount)
 	return res != WAIT_FAILED;
 }
 
+static void _GetProcessStats(HANDLE process, Process_Stats* stats)
+{
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+	if (GetProcessTimes(process, &creationTime, &exitTime, &kernelTime, &userTime)) {
+		// 'FILETIME' is in 100 nanosecond units
+		stats->userTimeUs = (((uint64_t) userTime.dwHighDateTime << 32) | userTime.dwLowDateTime) / 10;
+		stats->sysTimeUs  = (((uint64_t) kernelTime.dwHighDateTime << 32) | kernelTime.dwLowDateTime) / 10;
+	}
+
+	PROCESS_MEMORY_COUNTERS memCounters = {0};
+	memCounters.cb = sizeof(memCounters);
+	if (K32GetProcessMemoryInfo(process, &memCounters, sizeof(memCounters)))
+		stats->maxRssKb = (uint64_t) memCounters.PeakWorkingSetSize / 1024;
+
+	IO_COUNTERS ioCounters = {0};
+	if (GetProcessIoCounters(process, &ioCounters)) {
+		stats->ioReadKb = ioCounters.ReadTransferCount / 1024;
+		stats->ioWriteKb = ioCounters.WriteTransferCount / 1024;
+	}
+}
+
+// The totals of everything that ran in the job, not just the process we waited for
+static void _GetJobObjectStats(HANDLE jobObject, uint64_t memoryMax, Process_Stats* stats)
+{
+	JOBOBJECT_BASIC_AND_IO_ACCOUNTING_INFORMATION accounting = {0};
+	if (QueryInformationJobObject(jobObject, JobObjectBasicAndIoAccountingInformation, &accounting, sizeof(accounting), NULL)) {
+		stats->userTimeUs = (uint64_t) accounting.BasicInfo.TotalUserTime.QuadPart / 10;
+		stats->sysTimeUs = (uint64_t) accounting.BasicInfo.TotalKernelTime.QuadPart / 10;
+		stats->ioReadKb = accounting.IoInfo.ReadTransferCount / 1024;
+		stats->ioWriteKb = accounting.IoInfo.WriteTransferCount / 1024;
+	}
+
+	JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits = {0};
+	if (QueryInformationJobObject(jobObject, JobObjectExtendedLimitInformation, &limits, sizeof(limits), NULL)) {
+		uint64_t peak = (uint64_t) limits.PeakJobMemoryUsed;
+		stats->maxRssKb = peak / 1024;
+		// Windows fails the allocation instead of killing the job, a failed job that got close to its limit
+		// most likely died of it
+		stats->oomKilled = memoryMax > 0 && stats->exitCode != 0 && peak >= memoryMax - memoryMax / 16;
+	}
+}
+
+// 'WaitForMultipleObjects()' can't wait on more than 'MAXIMUM_WAIT_OBJECTS' handles, 'RunJobs()' never runs more
+size_t WaitForAnyProcess(Process_Data* processList, size_t processCount, Process_Stats* stats)
+{
+	if (processCount > MAXIMUM_WAIT_OBJECTS)
+		return processCount;
+
+	HANDLE* handles = _alloca(sizeof(HANDLE) * processCount);
+	for (size_t i = 0; i < processCount; i += 1)
+		handles[i] = processList[i].processInfo.hProcess;
+
+	DWORD res = WaitForMultipleObjects(
+		(DWORD) processCount, handles,
+		FALSE, INFINITE
+	);
+
+	if (res == WAIT_FAILED || res >= WAIT_OBJECT_0 + processCount)
+		return processCount;
+
+	size_t index = (size_t) (res - WAIT_OBJECT_0);
+	Process_Data* process = &processList[index];
+
+	MemZero(stats, sizeof(Process_Stats));
+	_GetProcessStats(process->processInfo.hProcess, stats);
+
+	DWORD exitCode = 0;
+	GetExitCodeProcess(process->processInfo.hProcess, &exitCode);
+	stats->exitCode = (int) exitCode;
+	if (process->jobObject != NULL) {
+		_GetJobObjectStats(process->jobObject, process->memoryMax, stats);
+		CloseHandle(process->jobObject);
+	}
+
+	CloseHandle(process->processInfo.hThread);
+	CloseHandle(process->processInfo.hProcess);
+
+	return index;
+}
+
+void GetSelfStats(Process_Stats* stats)
+{
+	MemZero(stats, sizeof(Process_Stats));
+	_GetProcessStats(GetCurrentProcess(), stats);
+}
+
+uint64_t GetTimeUs()
+{
+	LARGE_INTEGER freq, counter;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&counter);
+
+	return (uint64_t) ((counter.QuadPart / freq.QuadPart) * 1000000ll + ((counter.QuadPart % freq.QuadPart) * 1000000ll) / freq.QuadPart);
+}
+
 size_t GetThreadCount()
 {
 	SYSTEM_INFO info = {0};
@@ -134,3 +554,135 @@ size_t GetThreadCount()
 
 	return (size_t) info.dwNumberOfProcessors;
 }
+
+uint64_t GetSystemTimeNs()
+{
+	FILETIME fileTime = {0};
+	GetSystemTimeAsFileTime(&fileTime);
+
+	uint64_t ticks = ((uint64_t) fileTime.dwHighDateTime << 32) | fileTime.dwLowDateTime;
+	return ticks * 100;
+}
+
+char* GetLtoFlags(Arena* arena, char* compiler, char* linkFlags, char* ltoJobs, size_t freeSlots, char* ltoPartition, char* ltoCache)
+{
+	(void) compiler;
+	(void) ltoPartition;
+	(void) ltoCache;
+
+	if (strstr(linkFlags, "/LTCG") == NULL)
+		return NULL;
+
+	size_t jobs = freeSlots;
+	if (!StrCmp(ltoJobs, "auto") && !StrCmp(ltoJobs, "jobserver"))
+		jobs = (size_t) strtoull(ltoJobs, NULL, 10);
+
+	// 'link.exe' doesn't accept more than 8 code generation threads
+	if (jobs == 0)
+		jobs = 1;
+	if (jobs > 8)
+		jobs = 8;
+
+	const char* flagsFmt = "/CGTHREADS:%zu";
+	size_t flagsLen = 1 + snprintf(NULL, 0, flagsFmt, jobs);
+	char* flags = (char*) ArenaAlloc(arena, flagsLen);
+	snprintf(flags, flagsLen, flagsFmt, jobs);
+
+	return flags;
+}
+
+// 'linker' is 'default' or 'link', 'lld' or 'auto', which takes lld-link when it's installed.
+// Only link.exe relinks incrementally.
+char* GetLinkerFlags(Arena* arena, char* compiler, char* linker, char* linkFlags, size_t threads, bool incremental, char** program)
+{
+	(void) compiler;
+	(void) linkFlags;
+
+	bool useLld = StrCmp(linker, "lld");
+	if (StrCmp(linker, "auto"))
+		useLld = ResolveProgramPath("lld-link.exe") != NULL;
+	else if (!useLld && !StrCmp(linker, "link") && !StrCmp(linker, "default"))
+		fprintf(stderr, "Warning: unknown linker '%s', using link.exe\n", linker);
+
+	if (useLld && ResolveProgramPath("lld-link.exe") == NULL) {
+		fprintf(stderr, "Warning: linker 'lld' not found, using link.exe\n");
+		useLld = false;
+	}
+
+	*program = useLld ? "lld-link.exe" : NULL;
+	if (useLld) {
+		if (incremental)
+			fprintf(stderr, "Warning: lld-link can't relink incrementally, doing full links\n");
+
+		const char* flagsFmt = "/threads:%zu";
+		size_t flagsLen = 1 + snprintf(NULL, 0, flagsFmt, threads > 0 ? threads : 1);
+		char* flags = (char*) ArenaAlloc(arena, flagsLen);
+		snprintf(flags, flagsLen, flagsFmt, threads > 0 ? threads : 1);
+		return flags;
+	}
+
+	// Comes after the link flags, so it wins over an '/INCREMENTAL:NO' in there
+	return incremental ? ArenaStrDup(arena, "/INCREMENTAL", StrLen("/INCREMENTAL")) : NULL;
+}
+
+// TODO: MSVC doesn't have an LTO cache, so there's nothing to report
+bool GetCacheDirStats(char* path, uint64_t since, size_t* entries, size_t* touched)
+{
+	char findPath[MAX_PATH];
+	if (PathCombineA(findPath, path, "*") == NULL)
+		return false;
+
+	WIN32_FIND_DATAA fileData = {};
+	HANDLE find = FindFirstFileA(findPath, &fileData);
+	if (find == INVALID_HANDLE_VALUE)
+		return false;
+
+	*entries = 0;
+	*touched = 0;
+
+	do {
+		if (fileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			continue;
+
+		// Same 100ns-since-1601 clock as 'GetSystemTimeNs'
+		uint64_t ticks = ((uint64_t) fileData.ftLastWriteTime.dwHighDateTime << 32) | fileData.ftLastWriteTime.dwLowDateTime;
+		*entries += 1;
+		if (ticks * 100 >= since)
+			*touched += 1;
+	} while (FindNextFileA(find, &fileData));
+
+	FindClose(find);
+
+	return true;
+}
+
+// Runs 'cmd' through the shell, stdout and whatever it redirects into it. NULL when it can't run or fails.
+char* CaptureProcessOutput(char* cmd, size_t* size)
+{
+	FILE* pipe = _popen(cmd, "rb");
+	if (pipe == NULL)
+		return NULL;
+
+	size_t used = 0;
+	size_t capacity = 64 * 1024;
+	char* output = (char*) malloc(capacity);
+	while (true) {
+		if (used == capacity) {
+			capacity *= 2;
+			output = (char*) realloc(output, capacity);
+		}
+
+		size_t readSize = fread(&output[used], 1, capacity - used, pipe);
+		if (readSize == 0)
+			break;
+		used += readSize;
+	}
+
+	if (_pclose(pipe) != 0) {
+		free(output);
+		return NULL;
+	}
+
+	*size = used;
+	return output;
+}
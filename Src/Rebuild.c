@@ -0,0 +1,536 @@
+// Incremental builds: a job runs again only when its command changed since the last successful build,
+// or when its output is older than its inputs. The inputs of a compile are its source plus the headers
+// the compiler wrote to the unit's dependency file. A link also runs again when an object it read changed,
+// objects that were compiled again but came out byte for byte the same don't count (early cutoff).
+
+#define STATE_FILE_NAME "CBuilder.state"
+#define HASH_SEED 14695981039346656037ull
+
+typedef enum Dirty_Reason {
+	DIRTY_NONE,
+	DIRTY_OUTPUT_MISSING,
+	DIRTY_NO_RECORD,
+	DIRTY_COMMAND,
+	DIRTY_SOURCE,
+	DIRTY_DEPS_MISSING,
+	DIRTY_HEADER,
+} Dirty_Reason;
+
+typedef struct Dirty_Check {
+	Dirty_Reason reason;
+	char* detail;
+	// Up to date, but the output is gone and has to be rebuilt before anything reads it again
+	bool evicted;
+} Dirty_Check;
+
+// What the previous build recorded, one command hash, how long the job took and its content hash per job name
+typedef struct Build_State {
+	char** names;
+	uint64_t* hashes;
+	uint64_t* durationsUs;
+	uint64_t* contentHashes;
+	size_t size;
+	size_t* slots; // Index + 1, 0 is an empty slot
+	size_t slotCount;
+} Build_State;
+
+// FNV-1a, 'hash' is either 'HASH_SEED' or the result of a previous call to chain them
+uint64_t HashStr(const char* str, size_t len, uint64_t hash)
+{
+	for (size_t i = 0; i < len; i += 1) {
+		hash ^= (uint8_t) str[i];
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+static void _InsertBuildState(Build_State* state, size_t index)
+{
+	char* name = state->names[index];
+	size_t slot = HashStr(name, StrLen(name), HASH_SEED) & (state->slotCount - 1);
+	while (state->slots[slot] != 0)
+		slot = (slot + 1) & (state->slotCount - 1);
+
+	state->slots[slot] = index + 1;
+}
+
+// A missing or unreadable state file is an empty state, every job is dirty then
+Build_State LoadBuildState(Arena* arena, char* path)
+{
+	Build_State state = {0};
+
+	Mapped_File stateData = {0};
+	if (!IsFileValid(path) || !MapFile(path, &stateData))
+		return state;
+
+	size_t lineCount = 0;
+	for (size_t i = 0; i < stateData.size; i += 1) {
+		if (stateData.data[i] == '\n')
+			lineCount += 1;
+	}
+
+	state.names = (char**) ArenaAlloc(arena, sizeof(char*) * lineCount);
+	state.hashes = (uint64_t*) ArenaAlloc(arena, sizeof(uint64_t) * lineCount);
+	state.durationsUs = (uint64_t*) ArenaAlloc(arena, sizeof(uint64_t) * lineCount);
+	state.contentHashes = (uint64_t*) ArenaAlloc(arena, sizeof(uint64_t) * lineCount);
+	state.slotCount = 16;
+	while (state.slotCount < lineCount * 2)
+		state.slotCount *= 2;
+	state.slots = (size_t*) ArenaAlloc(arena, sizeof(size_t) * state.slotCount);
+	MemZero(state.slots, sizeof(size_t) * state.slotCount);
+
+	// Every line is '<hash> <durationUs> <contentHash> <name>', older ones have no content hash or duration
+	char* line = stateData.data;
+	while (state.size < lineCount) {
+		char* lineEnd = strchr(line, '\n');
+		if (lineEnd == NULL)
+			break;
+
+		char* nameStart = NULL;
+		uint64_t hash = strtoull(line, &nameStart, 16);
+		if (nameStart != line && *nameStart == ' ' && nameStart + 1 < lineEnd) {
+			nameStart += 1;
+			char* durationEnd = NULL;
+			uint64_t durationUs = strtoull(nameStart, &durationEnd, 10);
+			if (durationEnd != nameStart && *durationEnd == ' ' && durationEnd + 1 < lineEnd)
+				nameStart = durationEnd + 1;
+			else
+				durationUs = 0;
+
+			// Always 16 digits, so a name can't be mistaken for it
+			uint64_t contentHash = 0;
+			char* contentEnd = NULL;
+			if (lineEnd - nameStart > 17 && nameStart[16] == ' ') {
+				contentHash = strtoull(nameStart, &contentEnd, 16);
+				if (contentEnd == &nameStart[16])
+					nameStart = contentEnd + 1;
+				else
+					contentHash = 0;
+			}
+
+			state.names[state.size] = ArenaStrDup(arena, nameStart, (size_t) (lineEnd - nameStart));
+			state.hashes[state.size] = hash;
+			state.durationsUs[state.size] = durationUs;
+			state.contentHashes[state.size] = contentHash;
+			_InsertBuildState(&state, state.size);
+			state.size += 1;
+		}
+
+		line = lineEnd + 1;
+	}
+
+	UnmapFile(&stateData);
+
+	return state;
+}
+
+// 'durationUs' and 'contentHash' are optional, they're 0 when the job was recorded without them
+bool FindBuildState(Build_State* state, char* name, uint64_t* hash, uint64_t* durationUs, uint64_t* contentHash)
+{
+	if (state->size == 0)
+		return false;
+
+	size_t slot = HashStr(name, StrLen(name), HASH_SEED) & (state->slotCount - 1);
+	while (state->slots[slot] != 0) {
+		size_t index = state->slots[slot] - 1;
+		if (StrCmp(state->names[index], name)) {
+			*hash = state->hashes[index];
+			if (durationUs != NULL)
+				*durationUs = state->durationsUs[index];
+			if (contentHash != NULL)
+				*contentHash = state->contentHashes[index];
+			return true;
+		}
+
+		slot = (slot + 1) & (state->slotCount - 1);
+	}
+
+	return false;
+}
+
+// Records every job that succeeded now, or was up to date and keeps its previous record.
+// Failed jobs and jobs that never ran are left out, so they are dirty the next time.
+bool WriteBuildState(char* path, Job* jobs, size_t jobCount, Build_State* previous)
+{
+	FILE* file = fopen(path, "w");
+	if (file == NULL)
+		return false;
+
+	for (size_t i = 0; i < jobCount; i += 1) {
+		Job* job = &jobs[i];
+		if (job->name == NULL)
+			continue;
+
+		bool ran = job->endUs != 0;
+		uint64_t prevHash = 0;
+		uint64_t durationUs = ran ? job->endUs - job->startUs : 0;
+		uint64_t contentHash = job->contentHash;
+		bool keep = ran ? job->stats.exitCode == 0 : FindBuildState(previous, job->name, &prevHash, &durationUs, &contentHash) && prevHash == job->hash;
+		if (keep)
+			fprintf(file, "%016llx %llu %016llx %s\n", (unsigned long long) job->hash, (unsigned long long) durationUs,
+				(unsigned long long) contentHash, job->name);
+	}
+
+	return fclose(file) == 0;
+}
+
+static bool _IsPathSeparator(char c)
+{
+	return c == '/' || c == '\\';
+}
+
+static bool _IsAbsolutePath(char* path)
+{
+	return _IsPathSeparator(path[0]) || (path[0] != '\0' && path[1] == ':');
+}
+
+// Mirrors the source tree under the output dir, so same-named sources in different dirs don't collide.
+// Sources outside of 'rootDir' go to '_external', named after a hash of their dir.
+char* GetObjectPath(Arena* arena, char* rootDir, char* source, const char* ext)
+{
+	size_t rootLen = StrLen(rootDir);
+	char* relPath = NULL;
+	if (!_IsAbsolutePath(source)) {
+		relPath = source;
+		while (relPath[0] == '.' && _IsPathSeparator(relPath[1]))
+			relPath += 2;
+		if (strstr(relPath, "..") != NULL)
+			relPath = NULL;
+	} else if (rootLen > 0 && strncmp(source, rootDir, rootLen) == 0 && _IsPathSeparator(source[rootLen])) {
+		relPath = &source[rootLen + 1];
+	}
+
+	char* name = source;
+	for (size_t i = 0; source[i] != '\0'; i += 1) {
+		if (_IsPathSeparator(source[i]))
+			name = &source[i + 1];
+	}
+	char* sourceExt = GetFileExtension(name);
+	size_t stemEnd = (sourceExt != NULL) ? (size_t) (sourceExt - source) - 1 : StrLen(source);
+
+	char* path = NULL;
+	if (relPath != NULL) {
+		size_t relLen = stemEnd - (size_t) (relPath - source);
+		size_t pathLen = 1 + snprintf(NULL, 0, "%.*s%s", (int) relLen, relPath, ext);
+		path = (char*) ArenaAlloc(arena, pathLen);
+		snprintf(path, pathLen, "%.*s%s", (int) relLen, relPath, ext);
+	} else {
+		unsigned long long dirHash = HashStr(source, (size_t) (name - source), HASH_SEED);
+		int stemLen = (int) (stemEnd - (size_t) (name - source));
+		const char* pathFmt = "_external/%016llx_%.*s%s";
+		size_t pathLen = 1 + snprintf(NULL, 0, pathFmt, dirHash, stemLen, name, ext);
+		path = (char*) ArenaAlloc(arena, pathLen);
+		snprintf(path, pathLen, pathFmt, dirHash, stemLen, name, ext);
+	}
+
+	return path;
+}
+
+// The compiler doesn't create the dirs it writes into, jobs of the same dir are next to each other
+bool CreateOutputDirs(Job* jobs, size_t jobCount, char* workDir)
+{
+	char dir[4096];
+	size_t lastDirLen = 0;
+	char* lastOutput = NULL;
+	for (size_t i = 0; i < jobCount; i += 1) {
+		char* output = jobs[i].output;
+		size_t dirLen = 0;
+		for (size_t j = 0; output[j] != '\0'; j += 1) {
+			if (_IsPathSeparator(output[j]))
+				dirLen = j;
+		}
+
+		if (dirLen == 0 || (lastOutput != NULL && dirLen == lastDirLen && strncmp(output, lastOutput, dirLen) == 0))
+			continue;
+
+		const char* dirFmt = (workDir[0] != '\0') ? "%s/%.*s" : "%s%.*s";
+		if ((size_t) snprintf(dir, sizeof(dir), dirFmt, workDir, (int) dirLen, output) >= sizeof(dir) || !CreateDirRecursive(dir))
+			return false;
+
+		lastOutput = output;
+		lastDirLen = dirLen;
+	}
+
+	return true;
+}
+
+// Paths written by the compiler are relative to the dir it ran in
+static bool _GetInputModTime(char* workDir, char* path, uint64_t* mtimeNs)
+{
+	if (_IsAbsolutePath(path) || workDir[0] == '\0')
+		return GetFileModTime(path, mtimeNs);
+
+	char fullPath[4096];
+	if ((size_t) snprintf(fullPath, sizeof(fullPath), "%s/%s", workDir, path) >= sizeof(fullPath))
+		return false;
+
+	return GetFileModTime(fullPath, mtimeNs);
+}
+
+// Make syntax as written by '-MMD': 'target: dep dep \', spaces inside a path are escaped
+static bool _CheckDepFile(Arena* arena, char* depPath, char* workDir, uint64_t outputTime, Dirty_Check* check)
+{
+	char depFullPath[4096];
+	const char* pathFmt = (workDir[0] != '\0' && !_IsAbsolutePath(depPath)) ? "%s/%s" : "%.0s%s";
+	if ((size_t) snprintf(depFullPath, sizeof(depFullPath), pathFmt, workDir, depPath) >= sizeof(depFullPath))
+		return false;
+
+	Mapped_File depData = {0};
+	if (!IsFileValid(depFullPath) || !MapFile(depFullPath, &depData))
+		return false;
+
+	char* c = strchr(depData.data, ':');
+	c = (c != NULL) ? c + 1 : &depData.data[depData.size];
+
+	char dep[4096];
+	while (*c != '\0') {
+		if (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n') {
+			c += 1;
+			continue;
+		}
+		if (c[0] == '\\' && (c[1] == '\n' || c[1] == '\r')) {
+			c += 1;
+			continue;
+		}
+
+		size_t depLen = 0;
+		while (*c != '\0' && *c != ' ' && *c != '\t' && *c != '\r' && *c != '\n' && depLen < sizeof(dep) - 1) {
+			if (c[0] == '\\' && (c[1] == ' ' || c[1] == '#')) {
+				c += 1;
+			} else if (c[0] == '\\' && (c[1] == '\n' || c[1] == '\r')) {
+				break;
+			} else if (c[0] == '$' && c[1] == '$') {
+				c += 1;
+			}
+
+			dep[depLen] = *c;
+			depLen += 1;
+			c += 1;
+		}
+		dep[depLen] = '\0';
+
+		// Phony targets from '-MP' end with a colon, they aren't inputs
+		if (depLen == 0 || dep[depLen - 1] == ':')
+			continue;
+
+		uint64_t depTime = 0;
+		if (!_GetInputModTime(workDir, dep, &depTime) || depTime > outputTime) {
+			check->reason = DIRTY_HEADER;
+			check->detail = ArenaStrDup(arena, dep, depLen);
+			break;
+		}
+	}
+
+	UnmapFile(&depData);
+
+	return true;
+}
+
+#define SHOW_INCLUDES_PREFIX "Note: including file:"
+
+// MSVC only lists the headers it reads on stdout with '/showIncludes', so that's captured at 'depPath' and turned
+// into a dependency file for 'output' here. Everything else the compiler printed is passed on to our stdout.
+// The prefix is the one English builds print, set 'VSLANG=1033' for a localized compiler.
+bool ConvertShowIncludes(char* depPath, char* workDir, char* output)
+{
+	char depFullPath[4096];
+	const char* pathFmt = (workDir[0] != '\0' && !_IsAbsolutePath(depPath)) ? "%s/%s" : "%.0s%s";
+	if ((size_t) snprintf(depFullPath, sizeof(depFullPath), pathFmt, workDir, depPath) >= sizeof(depFullPath))
+		return false;
+
+	FILE* file = fopen(depFullPath, "rb");
+	if (file == NULL)
+		return false;
+
+	fseek(file, 0, SEEK_END);
+	long capturedSize = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	if (capturedSize < 0) {
+		fclose(file);
+		return false;
+	}
+
+	char* captured = (char*) malloc((size_t) capturedSize + 1);
+	size_t readSize = fread(captured, 1, (size_t) capturedSize, file);
+	captured[readSize] = '\0';
+	fclose(file);
+
+	file = fopen(depFullPath, "wb");
+	if (file == NULL) {
+		free(captured);
+		return false;
+	}
+
+	fprintf(file, "%s:", output);
+	size_t prefixLen = StrLen(SHOW_INCLUDES_PREFIX);
+	char* line = captured;
+	while (*line != '\0') {
+		char* lineEnd = strchr(line, '\n');
+		lineEnd = (lineEnd != NULL) ? lineEnd + 1 : &line[StrLen(line)];
+
+		if (strncmp(line, SHOW_INCLUDES_PREFIX, prefixLen) != 0) {
+			fwrite(line, 1, (size_t) (lineEnd - line), stdout);
+			line = lineEnd;
+			continue;
+		}
+
+		// Nested includes are indented past the prefix
+		char* dep = &line[prefixLen];
+		while (*dep == ' ')
+			dep += 1;
+		char* depEnd = lineEnd;
+		while (depEnd > dep && (depEnd[-1] == '\n' || depEnd[-1] == '\r' || depEnd[-1] == ' '))
+			depEnd -= 1;
+
+		// Escaped the way '_CheckDepFile()' reads them back
+		fputs(" ", file);
+		for (char* c = dep; c < depEnd; c += 1) {
+			if (*c == ' ' || *c == '#')
+				fputc('\\', file);
+			else if (*c == '$')
+				fputc('$', file);
+			fputc(*c, file);
+		}
+
+		line = lineEnd;
+	}
+	fputs("\n", file);
+	fflush(stdout);
+	free(captured);
+
+	bool written = !ferror(file);
+	return (fclose(file) == 0) && written;
+}
+
+// Paths are relative to 'workDir', the dependency file is NULL when the compiler doesn't write one.
+// An output that went away after being consumed by something written at 'evictedTime' is checked against
+// that instead, when nothing else changed it's only 'evicted'. 0 treats a missing output as dirty.
+Dirty_Check CheckJob(Arena* arena, Build_State* state, Job* job, char* workDir, uint64_t evictedTime)
+{
+	Dirty_Check check = {0};
+
+	uint64_t outputTime = 0;
+	uint64_t prevHash = 0;
+	uint64_t sideTime = 0;
+	bool evicted = false;
+	if (!_GetInputModTime(workDir, job->output, &outputTime)
+		|| (job->sideOutput != NULL && !_GetInputModTime(workDir, job->sideOutput, &sideTime))) {
+		if (evictedTime == 0) {
+			check.reason = DIRTY_OUTPUT_MISSING;
+			return check;
+		}
+		outputTime = evictedTime;
+		evicted = true;
+	}
+	if (!FindBuildState(state, job->name, &prevHash, NULL, NULL)) {
+		check.reason = DIRTY_NO_RECORD;
+		return check;
+	}
+	if (prevHash != job->hash) {
+		check.reason = DIRTY_COMMAND;
+		return check;
+	}
+
+	uint64_t sourceTime = 0;
+	if (!_GetInputModTime(workDir, job->name, &sourceTime) || sourceTime > outputTime) {
+		check.reason = DIRTY_SOURCE;
+		return check;
+	}
+
+	if (job->depFile != NULL && !_CheckDepFile(arena, job->depFile, workDir, outputTime, &check))
+		check.reason = DIRTY_DEPS_MISSING;
+
+	check.evicted = evicted && check.reason == DIRTY_NONE;
+
+	return check;
+}
+
+// The bytes of the job's output and side output, 0 when one of them can't be read
+uint64_t HashJobOutput(Job* job)
+{
+	char* outputs[2] = { job->output, job->sideOutput };
+	uint64_t hash = HASH_SEED;
+	for (size_t i = 0; i < 2 && outputs[i] != NULL; i += 1) {
+		char path[4096];
+		const char* pathFmt = (_IsAbsolutePath(outputs[i]) || job->workDir[0] == '\0') ? "%.0s%s" : "%s/%s";
+		if ((size_t) snprintf(path, sizeof(path), pathFmt, job->workDir, outputs[i]) >= sizeof(path))
+			return 0;
+
+		Mapped_File outputData = {0};
+		if (!IsFileValid(path) || !MapFile(path, &outputData))
+			return 0;
+
+		hash = HashStr(outputData.data, outputData.size, hash);
+		UnmapFile(&outputData);
+	}
+
+	return hash;
+}
+
+// What a link reads, the content hash of every unit but the one at 'skip'. Summed, so it doesn't depend on
+// the order the units ran in.
+uint64_t HashLinkInputs(Job* jobs, size_t jobCount, size_t skip)
+{
+	uint64_t hash = 0;
+	for (size_t i = 0; i < jobCount; i += 1) {
+		if (i == skip)
+			continue;
+
+		uint64_t unitHash = HashStr(jobs[i].name, StrLen(jobs[i].name), HASH_SEED);
+		hash += HashStr((char*) &jobs[i].contentHash, sizeof(uint64_t), unitHash);
+	}
+
+	return hash;
+}
+
+void PrintDirtyReason(Job* job, Dirty_Check* check)
+{
+	switch (check->reason) {
+		case DIRTY_NONE:
+			printf("%s: up to date\n", job->name);
+			break;
+		case DIRTY_OUTPUT_MISSING:
+			printf("%s: output missing\n", job->name);
+			break;
+		case DIRTY_NO_RECORD:
+			printf("%s: not built by a previous run\n", job->name);
+			break;
+		case DIRTY_COMMAND:
+			printf("%s: flags or compiler changed\n", job->name);
+			break;
+		case DIRTY_SOURCE:
+			printf("%s: source changed\n", job->name);
+			break;
+		case DIRTY_DEPS_MISSING:
+			printf("%s: dependency file missing\n", job->name);
+			break;
+		case DIRTY_HEADER:
+			printf("%s: header '%s' changed\n", job->name, check->detail);
+			break;
+	}
+}
+
+// Moves the dirty jobs to the front and the clean ones behind them, one slot apart so the link can follow
+// the compiles it depends on. 'jobs' has room for 'jobCount + 1' jobs, returns how many are dirty.
+size_t PartitionDirtyJobs(Arena* arena, Job* jobs, size_t jobCount, Dirty_Check* checks)
+{
+	Job* clean = (Job*) ArenaAlloc(arena, sizeof(Job) * (jobCount + 1));
+	size_t cleanCount = 0;
+	size_t dirtyCount = 0;
+	for (size_t i = 0; i < jobCount; i += 1) {
+		if (checks[i].reason == DIRTY_NONE) {
+			clean[cleanCount] = jobs[i];
+			cleanCount += 1;
+		} else {
+			jobs[dirtyCount] = jobs[i];
+			dirtyCount += 1;
+		}
+	}
+
+	MemZero(&jobs[dirtyCount], sizeof(Job));
+	if (cleanCount > 0)
+		MemCpy(&jobs[dirtyCount + 1], clean, sizeof(Job) * cleanCount);
+
+	return dirtyCount;
+}
@@ -0,0 +1,463 @@
+// Distributed compilation: compile jobs can run on 'CBuilderWorker' daemons, listed as 'host[:port][/jobs]'.
+// A remote job is CBuilder itself started with '--dispatch', it preprocesses the unit here, sends it to the worker
+// and writes back the object it gets. When the worker is busy or unreachable it exits with 'REMOTE_EXIT_LOCAL' and
+// 'RunJobs()' compiles the unit on a local slot instead, so the fallbacks never run past the local jobs.
+//
+// Every unit goes through two stages: preprocessing runs here and streams into the socket, code generation runs on
+// the worker. A worker queues the units past its jobs, so each one gets 'lookahead' more connections than it has
+// jobs: the next units get preprocessed and sent while the current ones are still compiling.
+//
+// One unit per connection:
+//	worker -> "OK\n", or "BUSY\n" when its jobs and its queue are full
+//	client -> "CBW3 <argCount> <argBytes> <ext>\n", the NUL terminated compiler args, the preprocessed unit in chunks
+//	          of "<hex size>\n" and the bytes, ended by "0\n". A connection closed before that cut the unit short.
+//	worker -> "CBW3 <exitCode> <logBytes> <objectBytes>\n", the compiler output, the object
+
+#define REMOTE_MAGIC "CBW3"
+#define REMOTE_CHUNK_SIZE (64 * 1024)
+#define REMOTE_DEFAULT_PORT "7878"
+#define REMOTE_DEFAULT_JOBS 4
+#define REMOTE_DEFAULT_LOOKAHEAD 2
+#define REMOTE_CONNECT_TIMEOUT_MS 500
+// 'EX_TEMPFAIL', the unit wasn't compiled and goes back to a local slot
+#define REMOTE_EXIT_LOCAL 75
+
+typedef struct Remote_Worker {
+	char* host;
+	char* port;
+	size_t jobs;
+} Remote_Worker;
+
+typedef struct Remote_Pool {
+	Remote_Worker* workers;
+	size_t workerCount;
+	// Slot 'i' goes to 'workers[slotWorkers[i]]', interleaved so a handful of jobs still spreads across all of them
+	size_t* slotWorkers;
+	size_t slotCount;
+	// Extra slots per worker, the units they take wait in the worker's queue
+	size_t lookahead;
+	char* selfPath;
+} Remote_Pool;
+
+static void _AssignRemoteSlots(Arena* arena, Remote_Pool* pool)
+{
+	size_t maxSlots = 0;
+	pool->slotCount = 0;
+	for (size_t i = 0; i < pool->workerCount; i += 1) {
+		size_t slots = pool->workers[i].jobs + pool->lookahead;
+		pool->slotCount += slots;
+		if (slots > maxSlots)
+			maxSlots = slots;
+	}
+
+	pool->slotWorkers = (size_t*) ArenaAlloc(arena, sizeof(size_t) * (pool->slotCount + 1));
+	size_t slot = 0;
+	for (size_t round = 0; round < maxSlots; round += 1) {
+		for (size_t i = 0; i < pool->workerCount; i += 1) {
+			if (round < pool->workers[i].jobs + pool->lookahead) {
+				pool->slotWorkers[slot] = i;
+				slot += 1;
+			}
+		}
+	}
+}
+
+// 'workers' is a comma separated list, an empty pool means every job runs locally
+bool LoadRemotePool(Arena* arena, char* workers, char* lookahead, Remote_Pool* pool)
+{
+	MemZero(pool, sizeof(Remote_Pool));
+	if (workers == NULL)
+		return true;
+
+	pool->lookahead = (lookahead != NULL) ? (size_t) strtoull(lookahead, NULL, 10) : REMOTE_DEFAULT_LOOKAHEAD;
+
+#if !defined(__linux__)
+	fprintf(stderr, "Warning: distributed compilation is only supported on Linux, building locally\n");
+	return true;
+#endif
+
+	pool->selfPath = GetExecutablePath(arena);
+	if (pool->selfPath == NULL) {
+		fprintf(stderr, "Error trying to find the CBuilder executable for the remote jobs\n");
+		return false;
+	}
+
+	Str_List workerList = SplitStringList(arena, workers);
+	pool->workers = (Remote_Worker*) ArenaAlloc(arena, sizeof(Remote_Worker) * (workerList.size + 1));
+	for (size_t i = 0; i < workerList.size; i += 1) {
+		char* entry = ArenaStrDup(arena, GetStrList(&workerList, i), workerList.lengths[i]);
+		Remote_Worker* worker = &pool->workers[pool->workerCount];
+		worker->host = entry;
+		worker->port = REMOTE_DEFAULT_PORT;
+		worker->jobs = REMOTE_DEFAULT_JOBS;
+
+		char* jobs = strchr(entry, '/');
+		if (jobs != NULL) {
+			*jobs = '\0';
+			worker->jobs = (size_t) strtoull(&jobs[1], NULL, 10);
+		}
+
+		char* port = strrchr(entry, ':');
+		if (port != NULL) {
+			*port = '\0';
+			worker->port = &port[1];
+		}
+
+		if (worker->host[0] == '\0' || worker->port[0] == '\0' || worker->jobs == 0) {
+			fprintf(stderr, "Invalid worker '%s', expected 'host[:port][/jobs]'\n", GetStrList(&workerList, i));
+			return false;
+		}
+
+		pool->workerCount += 1;
+	}
+
+	_AssignRemoteSlots(arena, pool);
+
+	return true;
+}
+
+// The worker tells C from C++ by the extension of the preprocessed unit, the same way gcc tells them apart by the
+// source's. NULL for anything else, assembly or Objective-C included, those units are always compiled locally.
+char* GetRemoteUnitExt(char* source)
+{
+	char* ext = GetFileExtension(GetFilenameFromPath(source));
+	if (ext == NULL)
+		return NULL;
+	if (StrCmp(ext, "c"))
+		return ".i";
+
+	const char* cppExts[] = { "cc", "cp", "cxx", "cpp", "CPP", "c++", "C" };
+	for (size_t i = 0; i < sizeof(cppExts) / sizeof(cppExts[0]); i += 1) {
+		if (StrCmp(ext, cppExts[i]))
+			return ".ii";
+	}
+
+	return NULL;
+}
+
+// The remote job for a compile, 'job->remoteArgs' is the compiler and its flags without the mode ones
+char* FormatDispatchCmd(Remote_Pool* pool, size_t slot, Job* job)
+{
+	Remote_Worker* worker = &pool->workers[pool->slotWorkers[slot]];
+
+	const char* cmdFmt = "\"%s\" --dispatch %s:%s \"%s\" \"%s\" \"%s\" %s";
+	size_t cmdLen = 1 + snprintf(NULL, 0, cmdFmt, pool->selfPath, worker->host, worker->port, job->output, job->depFile, job->name, job->remoteArgs);
+	char* cmd = (char*) malloc(cmdLen);
+	snprintf(cmd, cmdLen, cmdFmt, pool->selfPath, worker->host, worker->port, job->output, job->depFile, job->name, job->remoteArgs);
+
+	return cmd;
+}
+
+#if defined(__linux__)
+
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+static int _ConnectWorker(char* host, char* port)
+{
+	struct addrinfo hints = {0};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	struct addrinfo* addrs = NULL;
+	if (getaddrinfo(host, port, &hints, &addrs) != 0)
+		return -1;
+
+	int sock = -1;
+	for (struct addrinfo* addr = addrs; addr != NULL && sock == -1; addr = addr->ai_next) {
+		sock = socket(addr->ai_family, addr->ai_socktype | SOCK_CLOEXEC, addr->ai_protocol);
+		if (sock == -1)
+			continue;
+
+		// Non blocking only while connecting, so an unreachable worker costs the timeout and not the system one
+		int flags = fcntl(sock, F_GETFL);
+		fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+		bool connected = connect(sock, addr->ai_addr, addr->ai_addrlen) == 0;
+		if (!connected && errno == EINPROGRESS) {
+			struct pollfd pfd = { .fd = sock, .events = POLLOUT };
+			int err = 0;
+			socklen_t errLen = sizeof(err);
+			connected = poll(&pfd, 1, REMOTE_CONNECT_TIMEOUT_MS) == 1 &&
+				getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &errLen) == 0 && err == 0;
+		}
+		fcntl(sock, F_SETFL, flags);
+
+		if (!connected) {
+			close(sock);
+			sock = -1;
+		}
+	}
+
+	freeaddrinfo(addrs);
+
+	return sock;
+}
+
+static bool _SendAll(int sock, const char* data, size_t size)
+{
+	while (size > 0) {
+		ssize_t sent = send(sock, data, size, MSG_NOSIGNAL);
+		if (sent <= 0) {
+			if (sent == -1 && errno == EINTR)
+				continue;
+			return false;
+		}
+
+		data += sent;
+		size -= (size_t) sent;
+	}
+
+	return true;
+}
+
+static bool _RecvAll(int sock, char* data, size_t size)
+{
+	while (size > 0) {
+		ssize_t received = recv(sock, data, size, 0);
+		if (received <= 0) {
+			if (received == -1 && errno == EINTR)
+				continue;
+			return false;
+		}
+
+		data += received;
+		size -= (size_t) received;
+	}
+
+	return true;
+}
+
+// Headers are a few bytes long, reading them one byte at a time never reads into the payload
+static bool _RecvLine(int sock, char* line, size_t capacity, int timeoutMs)
+{
+	for (size_t i = 0; i + 1 < capacity; i += 1) {
+		if (timeoutMs >= 0) {
+			struct pollfd pfd = { .fd = sock, .events = POLLIN };
+			if (poll(&pfd, 1, timeoutMs) != 1)
+				return false;
+		}
+
+		if (!_RecvAll(sock, &line[i], 1))
+			return false;
+
+		if (line[i] == '\n') {
+			line[i] = '\0';
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Drops the workers that don't answer, so the jobs don't pay the connect timeout one by one
+void ProbeRemoteWorkers(Arena* arena, Remote_Pool* pool)
+{
+	size_t alive = 0;
+	for (size_t i = 0; i < pool->workerCount; i += 1) {
+		Remote_Worker* worker = &pool->workers[i];
+
+		char status[16];
+		int sock = _ConnectWorker(worker->host, worker->port);
+		bool ok = sock != -1 && _RecvLine(sock, status, sizeof(status), REMOTE_CONNECT_TIMEOUT_MS) &&
+			(StrCmp(status, "OK") || StrCmp(status, "BUSY"));
+		if (sock != -1)
+			close(sock);
+
+		if (!ok) {
+			fprintf(stderr, "Warning: worker '%s:%s' is unreachable, its jobs run locally\n", worker->host, worker->port);
+			continue;
+		}
+
+		pool->workers[alive] = *worker;
+		alive += 1;
+	}
+
+	pool->workerCount = alive;
+	_AssignRemoteSlots(arena, pool);
+}
+
+// The preprocess stage: every read from the preprocessor goes out as a chunk right away, so the worker receives
+// the unit while it's still being produced. Also writes the dependency file the local compile would have.
+// Only a preprocessor that succeeded ends the unit, -1 when the worker went away.
+static int _StreamUnit(int sock, char** args, size_t argCount, char* output, char* depPath, char* source)
+{
+	int pipeFds[2];
+	if (pipe(pipeFds) != 0)
+		return -1;
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		char** argv = (char**) malloc(sizeof(char*) * (argCount + 8));
+		MemCpy(argv, args, sizeof(char*) * argCount);
+		argv[argCount + 0] = "-E";
+		argv[argCount + 1] = "-MMD";
+		argv[argCount + 2] = "-MF";
+		argv[argCount + 3] = depPath;
+		argv[argCount + 4] = "-MT";
+		argv[argCount + 5] = output;
+		argv[argCount + 6] = source;
+		argv[argCount + 7] = NULL;
+
+		dup2(pipeFds[1], STDOUT_FILENO);
+		close(pipeFds[0]);
+		close(pipeFds[1]);
+		execvp(argv[0], argv);
+		_exit(127);
+	}
+
+	close(pipeFds[1]);
+	if (pid == -1) {
+		close(pipeFds[0]);
+		return -1;
+	}
+
+	// The chunk header goes right before the bytes, so both leave in a single send
+	static char chunk[32 + REMOTE_CHUNK_SIZE];
+	bool sent = true;
+	while (sent) {
+		ssize_t readSize = read(pipeFds[0], &chunk[32], REMOTE_CHUNK_SIZE);
+		if (readSize == -1 && errno == EINTR)
+			continue;
+		if (readSize <= 0)
+			break;
+
+		char header[32];
+		int headerLen = snprintf(header, sizeof(header), "%zx\n", (size_t) readSize);
+		MemCpy(&chunk[32 - headerLen], header, (size_t) headerLen);
+		sent = _SendAll(sock, &chunk[32 - headerLen], (size_t) headerLen + (size_t) readSize);
+	}
+
+	// A worker that goes away mid unit kills the preprocessor with 'SIGPIPE' once the pipe closes,
+	// that's a fallback and not an error
+	close(pipeFds[0]);
+	int status = 0;
+	if (waitpid(pid, &status, 0) == -1 || !sent || !WIFEXITED(status))
+		return -1;
+	if (WEXITSTATUS(status) != 0)
+		return WEXITSTATUS(status);
+
+	return _SendAll(sock, "0\n", 2) ? 0 : -1;
+}
+
+static bool _SendRequest(int sock, char** args, size_t argCount, char* source)
+{
+	size_t argBytes = 0;
+	for (size_t i = 0; i < argCount; i += 1)
+		argBytes += StrLen(args[i]) + 1;
+
+	char* unitExt = GetRemoteUnitExt(source);
+	if (unitExt == NULL)
+		return false;
+
+	char header[128];
+	int headerLen = snprintf(header, sizeof(header), REMOTE_MAGIC " %zu %zu %s\n", argCount, argBytes, unitExt);
+	if (!_SendAll(sock, header, (size_t) headerLen))
+		return false;
+	for (size_t i = 0; i < argCount; i += 1) {
+		if (!_SendAll(sock, args[i], StrLen(args[i]) + 1))
+			return false;
+	}
+
+	return true;
+}
+
+// Waits for the compile stage, -1 when the worker went away and the unit has to be compiled locally
+static int _ReceiveResult(int sock, char* output)
+{
+	char reply[128];
+	int exitCode = 0;
+	size_t logSize = 0;
+	size_t objSize = 0;
+	if (!_RecvLine(sock, reply, sizeof(reply), -1) || sscanf(reply, REMOTE_MAGIC " %d %zu %zu", &exitCode, &logSize, &objSize) != 3)
+		return -1;
+
+	char* payload = (char*) malloc(logSize + objSize + 1);
+	if (!_RecvAll(sock, payload, logSize + objSize)) {
+		free(payload);
+		return -1;
+	}
+
+	fwrite(payload, 1, logSize, stderr);
+
+	// Written next to it first, an interrupted build never leaves half an object behind
+	if (exitCode == 0) {
+		size_t tmpPathLen = StrLen(output) + 5;
+		char* tmpPath = (char*) malloc(tmpPathLen);
+		snprintf(tmpPath, tmpPathLen, "%s.tmp", output);
+
+		FILE* file = fopen(tmpPath, "wb");
+		bool written = file != NULL && fwrite(&payload[logSize], 1, objSize, file) == objSize;
+		written = (file != NULL && fclose(file) == 0) && written;
+		if (!written || rename(tmpPath, output) != 0) {
+			fprintf(stderr, "Error trying to write '%s'\n", output);
+			exitCode = 1;
+		}
+		free(tmpPath);
+	}
+	free(payload);
+
+	return exitCode;
+}
+
+// 'argv' is '<host:port> <output> <depfile> <source> <compiler> [flags]', the exit code is the compiler's,
+// or 'REMOTE_EXIT_LOCAL' when the unit has to be compiled locally
+int RunDispatch(int argc, char* argv[])
+{
+	if (argc < 5) {
+		fprintf(stderr, "Usage: CBuilder --dispatch <host:port> <output> <depfile> <source> <compiler> [flags]\n");
+		return -1;
+	}
+
+	char* host = argv[0];
+	char* output = argv[1];
+	char* depPath = argv[2];
+	char* source = argv[3];
+	char** args = &argv[4];
+	size_t argCount = (size_t) (argc - 4);
+
+	char* port = strrchr(host, ':');
+	if (port == NULL)
+		return REMOTE_EXIT_LOCAL;
+	*port = '\0';
+	port += 1;
+
+	char status[16];
+	int sock = _ConnectWorker(host, port);
+	if (sock == -1 || !_RecvLine(sock, status, sizeof(status), REMOTE_CONNECT_TIMEOUT_MS) || !StrCmp(status, "OK")) {
+		if (sock != -1)
+			close(sock);
+		return REMOTE_EXIT_LOCAL;
+	}
+
+	if (!_SendRequest(sock, args, argCount, source)) {
+		close(sock);
+		return REMOTE_EXIT_LOCAL;
+	}
+
+	// Headers and macros are resolved here, the worker only needs the compiler. A failed preprocess closes
+	// the connection before the last chunk, the worker drops the unit without compiling it.
+	int exitCode = _StreamUnit(sock, args, argCount, output, depPath, source);
+	if (exitCode != 0) {
+		close(sock);
+		return exitCode != -1 ? exitCode : REMOTE_EXIT_LOCAL;
+	}
+
+	exitCode = _ReceiveResult(sock, output);
+	close(sock);
+
+	if (exitCode == -1)
+		return REMOTE_EXIT_LOCAL;
+
+	return exitCode;
+}
+
+#else
+
+void ProbeRemoteWorkers(Arena* arena, Remote_Pool* pool)
+{
+	(void) arena;
+	(void) pool;
+}
+
+#endif
@@ -0,0 +1,227 @@
+// End of build summary, printed for humans or written as JSON for dashboards
+
+#define SUMMARY_TOP_UNITS 10
+
+typedef struct Build_Summary {
+	uint64_t wallUs;
+	uint64_t userTimeUs;
+	uint64_t sysTimeUs;
+	uint64_t jobsWallUs;
+	double avgParallelism;
+	size_t peakParallelism;
+	size_t slotCount;
+	uint64_t criticalPathUs;
+	Job* criticalCompile;
+	Job* criticalLink;
+	size_t compiledUnits;
+	size_t skippedUnits;
+	size_t failedJobs;
+	Job** slowestUnits;
+	size_t slowestCount;
+} Build_Summary;
+
+static uint64_t _JobDuration(Job* job)
+{
+	return job->endUs > job->startUs ? job->endUs - job->startUs : 0;
+}
+
+static int _CompareU64(const void* a, const void* b)
+{
+	uint64_t valA = *(const uint64_t*) a;
+	uint64_t valB = *(const uint64_t*) b;
+
+	return (valA > valB) - (valA < valB);
+}
+
+static int _CompareJobDurationDesc(const void* a, const void* b)
+{
+	uint64_t durA = _JobDuration(*(Job* const*) a);
+	uint64_t durB = _JobDuration(*(Job* const*) b);
+
+	return (durA < durB) - (durA > durB);
+}
+
+// The jobs of variant 'v' end at 'variantEnds[v]', every variant's link depends only on its own compiles
+Build_Summary ComputeBuildSummary(Job* jobs, size_t jobCount, size_t* variantEnds, size_t variantCount, size_t slotCount, uint64_t wallUs, size_t skippedUnits)
+{
+	Build_Summary summary = {
+		.wallUs = wallUs,
+		.slotCount = slotCount,
+		.skippedUnits = skippedUnits,
+	};
+
+	Process_Stats self = {0};
+	GetSelfStats(&self);
+	summary.userTimeUs = self.userTimeUs;
+	summary.sysTimeUs = self.sysTimeUs;
+
+	if (jobCount == 0)
+		return summary;
+
+	uint64_t* starts = (uint64_t*) malloc(sizeof(uint64_t) * jobCount);
+	uint64_t* ends = (uint64_t*) malloc(sizeof(uint64_t) * jobCount);
+	summary.slowestUnits = (Job**) malloc(sizeof(Job*) * jobCount);
+
+	uint64_t busyUs = 0;
+	uint64_t firstStart = UINT64_MAX;
+	uint64_t lastEnd = 0;
+	for (size_t i = 0; i < jobCount; i += 1) {
+		Job* job = &jobs[i];
+		starts[i] = job->startUs;
+		ends[i] = job->endUs;
+		busyUs += _JobDuration(job);
+		if (job->startUs < firstStart)
+			firstStart = job->startUs;
+		if (job->endUs > lastEnd)
+			lastEnd = job->endUs;
+
+		summary.userTimeUs += job->stats.userTimeUs;
+		summary.sysTimeUs += job->stats.sysTimeUs;
+		if (job->stats.exitCode != 0)
+			summary.failedJobs += 1;
+
+		if (StrCmp(job->category, "compile")) {
+			summary.compiledUnits += 1;
+			summary.slowestUnits[summary.slowestCount] = job;
+			summary.slowestCount += 1;
+		}
+	}
+
+	// Within a variant the longest chain is its slowest compile followed by its link, the build's is the longest of those
+	size_t variantStart = 0;
+	for (size_t v = 0; v < variantCount; v += 1) {
+		Job* slowestCompile = NULL;
+		Job* link = NULL;
+		for (size_t i = variantStart; i < variantEnds[v]; i += 1) {
+			Job* job = &jobs[i];
+			if (StrCmp(job->category, "compile") && (slowestCompile == NULL || _JobDuration(job) > _JobDuration(slowestCompile)))
+				slowestCompile = job;
+			else if (StrCmp(job->category, "link"))
+				link = job;
+		}
+		variantStart = variantEnds[v];
+
+		uint64_t pathUs = (slowestCompile != NULL ? _JobDuration(slowestCompile) : 0) + (link != NULL ? _JobDuration(link) : 0);
+		if (pathUs > summary.criticalPathUs) {
+			summary.criticalPathUs = pathUs;
+			summary.criticalCompile = slowestCompile;
+			summary.criticalLink = link;
+		}
+	}
+
+	summary.jobsWallUs = lastEnd > firstStart ? lastEnd - firstStart : 0;
+	if (summary.jobsWallUs > 0)
+		summary.avgParallelism = (double) busyUs / (double) summary.jobsWallUs;
+
+	// Sweep over the sorted start and end times to find the most jobs running at once
+	qsort(starts, jobCount, sizeof(uint64_t), _CompareU64);
+	qsort(ends, jobCount, sizeof(uint64_t), _CompareU64);
+	size_t running = 0;
+	size_t endIdx = 0;
+	for (size_t i = 0; i < jobCount; i += 1) {
+		while (endIdx < jobCount && ends[endIdx] <= starts[i]) {
+			running -= 1;
+			endIdx += 1;
+		}
+
+		running += 1;
+		if (running > summary.peakParallelism)
+			summary.peakParallelism = running;
+	}
+
+	qsort(summary.slowestUnits, summary.slowestCount, sizeof(Job*), _CompareJobDurationDesc);
+	if (summary.slowestCount > SUMMARY_TOP_UNITS)
+		summary.slowestCount = SUMMARY_TOP_UNITS;
+
+	free(ends);
+	free(starts);
+
+	return summary;
+}
+
+void PrintBuildSummary(Build_Summary* summary)
+{
+	double utilization = summary->slotCount > 0 ? 100.0 * summary->avgParallelism / (double) summary->slotCount : 0.0;
+
+	printf("--- Build summary ---\n");
+	printf("Wall time:     %.3f s\n", (double) summary->wallUs / 1e6);
+	printf("CPU time:      %.3f s (user %.3f s, sys %.3f s)\n",
+		(double) (summary->userTimeUs + summary->sysTimeUs) / 1e6,
+		(double) summary->userTimeUs / 1e6, (double) summary->sysTimeUs / 1e6);
+	printf("Parallelism:   avg %.2f, peak %zu of %zu slots (%.1f%% utilization)\n",
+		summary->avgParallelism, summary->peakParallelism, summary->slotCount, utilization);
+
+	printf("Critical path: %.3f s", (double) summary->criticalPathUs / 1e6);
+	if (summary->criticalCompile != NULL)
+		printf(" (%s %.3f s", summary->criticalCompile->name, (double) _JobDuration(summary->criticalCompile) / 1e6);
+	if (summary->criticalLink != NULL)
+		printf(" -> %s %.3f s", summary->criticalLink->name, (double) _JobDuration(summary->criticalLink) / 1e6);
+	if (summary->criticalCompile != NULL)
+		printf(")");
+	printf("\n");
+
+	printf("Units:         %zu compiled, %zu up to date, %zu failed jobs\n",
+		summary->compiledUnits, summary->skippedUnits, summary->failedJobs);
+
+	if (summary->slowestCount > 0) {
+		printf("Slowest units:\n");
+		for (size_t i = 0; i < summary->slowestCount; i += 1) {
+			Job* job = summary->slowestUnits[i];
+			printf("  %10.3f s  %s\n", (double) _JobDuration(job) / 1e6, job->name);
+		}
+	}
+}
+
+bool WriteBuildSummaryJson(Build_Summary* summary, char* path)
+{
+	FILE* file = fopen(path, "w");
+	if (file == NULL)
+		return false;
+
+	fprintf(file, "{\n");
+	fprintf(file, "  \"version\": \"%s\",\n", CBUILDER_VERSION);
+	fprintf(file, "  \"wallUs\": %llu,\n", (unsigned long long) summary->wallUs);
+	fprintf(file, "  \"userUs\": %llu,\n", (unsigned long long) summary->userTimeUs);
+	fprintf(file, "  \"sysUs\": %llu,\n", (unsigned long long) summary->sysTimeUs);
+	fprintf(file, "  \"slots\": %zu,\n", summary->slotCount);
+	fprintf(file, "  \"avgParallelism\": %.3f,\n", summary->avgParallelism);
+	fprintf(file, "  \"peakParallelism\": %zu,\n", summary->peakParallelism);
+	fprintf(file, "  \"criticalPathUs\": %llu,\n", (unsigned long long) summary->criticalPathUs);
+
+	fprintf(file, "  \"criticalPath\": [");
+	if (summary->criticalCompile != NULL) {
+		WriteJsonString(file, summary->criticalCompile->name);
+		if (summary->criticalLink != NULL)
+			fprintf(file, ", ");
+	}
+	if (summary->criticalLink != NULL)
+		WriteJsonString(file, summary->criticalLink->name);
+	fprintf(file, "],\n");
+
+	fprintf(file, "  \"compiledUnits\": %zu,\n", summary->compiledUnits);
+	fprintf(file, "  \"skippedUnits\": %zu,\n", summary->skippedUnits);
+	fprintf(file, "  \"failedJobs\": %zu,\n", summary->failedJobs);
+
+	fprintf(file, "  \"slowestUnits\": [");
+	for (size_t i = 0; i < summary->slowestCount; i += 1) {
+		Job* job = summary->slowestUnits[i];
+		fprintf(file, "%s\n    {\"name\": ", i > 0 ? "," : "");
+		WriteJsonString(file, job->name);
+		fprintf(file, ", \"wallUs\": %llu, \"userUs\": %llu, \"sysUs\": %llu, \"maxRssKb\": %llu, \"ioReadKb\": %llu, \"ioWriteKb\": %llu}",
+			(unsigned long long) _JobDuration(job), (unsigned long long) job->stats.userTimeUs,
+			(unsigned long long) job->stats.sysTimeUs, (unsigned long long) job->stats.maxRssKb,
+			(unsigned long long) job->stats.ioReadKb, (unsigned long long) job->stats.ioWriteKb);
+	}
+	fprintf(file, "%s]\n", summary->slowestCount > 0 ? "\n  " : "");
+	fprintf(file, "}\n");
+
+	bool written = !ferror(file);
+	return (fclose(file) == 0) && written;
+}
+
+void DestroyBuildSummary(Build_Summary* summary)
+{
+	free(summary->slowestUnits);
+	summary->slowestUnits = NULL;
+	summary->slowestCount = 0;
+}
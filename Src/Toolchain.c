@@ -0,0 +1,135 @@
+// Compiler identity for the rebuild checks: path, version, target and builtin defines, so replacing the compiler
+// rebuilds everything it built. Probing costs a compiler run, the result is cached in '<outputDir>/CBuilder.toolchain'
+// and reused for as long as the compiler binary keeps its inode, mtime and size.
+
+#define TOOLCHAIN_FILE_NAME "CBuilder.toolchain"
+
+typedef struct Toolchain_Entry {
+	uint64_t fingerprint;
+	File_Identity identity;
+	char* path;
+} Toolchain_Entry;
+
+// Every line is '<fingerprint> <id> <mtime> <size> <path>', one per compiler that was probed
+static size_t _LoadToolchainCache(Arena* arena, char* cachePath, Toolchain_Entry** entries)
+{
+	*entries = NULL;
+	Mapped_File cacheData = {0};
+	if (!IsFileValid(cachePath) || !MapFile(cachePath, &cacheData))
+		return 0;
+
+	size_t lineCount = 0;
+	for (size_t i = 0; i < cacheData.size; i += 1) {
+		if (cacheData.data[i] == '\n')
+			lineCount += 1;
+	}
+
+	*entries = (Toolchain_Entry*) ArenaAlloc(arena, sizeof(Toolchain_Entry) * (lineCount + 1));
+	size_t entryCount = 0;
+	char* line = cacheData.data;
+	while (entryCount < lineCount) {
+		char* lineEnd = strchr(line, '\n');
+		if (lineEnd == NULL)
+			break;
+
+		Toolchain_Entry* entry = &(*entries)[entryCount];
+		char* cursor = line;
+		entry->fingerprint = strtoull(cursor, &cursor, 16);
+		entry->identity.id = strtoull(cursor, &cursor, 16);
+		entry->identity.mtimeNs = strtoull(cursor, &cursor, 16);
+		entry->identity.size = strtoull(cursor, &cursor, 16);
+		if (*cursor == ' ' && cursor + 1 < lineEnd) {
+			entry->path = ArenaStrDup(arena, cursor + 1, (size_t) (lineEnd - cursor - 1));
+			entryCount += 1;
+		}
+
+		line = lineEnd + 1;
+	}
+
+	UnmapFile(&cacheData);
+
+	return entryCount;
+}
+
+static bool _WriteToolchainCache(char* cachePath, Toolchain_Entry* entries, size_t entryCount)
+{
+	FILE* file = fopen(cachePath, "w");
+	if (file == NULL)
+		return false;
+
+	for (size_t i = 0; i < entryCount; i += 1) {
+		Toolchain_Entry* entry = &entries[i];
+		fprintf(file, "%016llx %llx %llx %llx %s\n", (unsigned long long) entry->fingerprint,
+			(unsigned long long) entry->identity.id, (unsigned long long) entry->identity.mtimeNs,
+			(unsigned long long) entry->identity.size, entry->path);
+	}
+
+	return fclose(file) == 0;
+}
+
+// 'compilerPath' is the resolved binary and 'compilerArgs' what the compiler property passes it before anything else,
+// "" or starting with a space. 'probeFmt' is the command that prints its identity, with '%s' for the path and then
+// the args, so a wrapper like 'ccache gcc' is probed as a whole. Only fails when the compiler can't be found,
+// a probe that fails falls back to the binary's identity.
+bool GetToolchainFingerprint(Arena* arena, char* compilerPath, char* compilerArgs, const char* probeFmt, char* cachePath, uint64_t* fingerprint)
+{
+	File_Identity identity = {0};
+	if (!GetFileIdentity(compilerPath, &identity))
+		return false;
+
+	// The same binary with other args is another toolchain
+	size_t keyLen = 1 + snprintf(NULL, 0, "%s%s", compilerPath, compilerArgs);
+	char* key = (char*) ArenaAlloc(arena, keyLen);
+	snprintf(key, keyLen, "%s%s", compilerPath, compilerArgs);
+
+	Toolchain_Entry* entries = NULL;
+	size_t entryCount = _LoadToolchainCache(arena, cachePath, &entries);
+	Toolchain_Entry* entry = NULL;
+	for (size_t i = 0; i < entryCount && entry == NULL; i += 1) {
+		if (StrCmp(entries[i].path, key))
+			entry = &entries[i];
+	}
+
+	if (entry != NULL && MemCmp(&entry->identity, &identity, sizeof(File_Identity))) {
+		*fingerprint = entry->fingerprint;
+		return true;
+	}
+
+	size_t probeLen = 1 + snprintf(NULL, 0, probeFmt, compilerPath, compilerArgs);
+	char* probeCmd = (char*) ArenaAlloc(arena, probeLen);
+	snprintf(probeCmd, probeLen, probeFmt, compilerPath, compilerArgs);
+
+	uint64_t hash = HashStr(key, keyLen - 1, HASH_SEED);
+	size_t outputSize = 0;
+	char* output = CaptureProcessOutput(probeCmd, &outputSize);
+	if (output != NULL) {
+		hash = HashStr(output, outputSize, hash);
+		free(output);
+	} else {
+		fprintf(stderr, "Warning: couldn't probe '%s', only its path and timestamp identify it\n", compilerPath);
+		hash = HashStr((char*) &identity, sizeof(File_Identity), hash);
+	}
+
+	// The first probe for this compiler, or the binary changed since the last one
+	if (entry == NULL) {
+		Toolchain_Entry* grown = (Toolchain_Entry*) ArenaAlloc(arena, sizeof(Toolchain_Entry) * (entryCount + 1));
+		if (entryCount > 0)
+			MemCpy(grown, entries, sizeof(Toolchain_Entry) * entryCount);
+		entries = grown;
+		entry = &entries[entryCount];
+		entry->path = key;
+		entryCount += 1;
+	}
+	entry->fingerprint = hash;
+	entry->identity = identity;
+
+	char* cacheDir = GetDirFromPath(arena, cachePath);
+	if (cacheDir[0] != '\0')
+		CreateDirRecursive(cacheDir);
+	if (!_WriteToolchainCache(cachePath, entries, entryCount))
+		fprintf(stderr, "Warning: couldn't write the toolchain cache '%s'\n", cachePath);
+
+	*fingerprint = hash;
+
+	return true;
+}
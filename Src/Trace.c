@@ -0,0 +1,163 @@
+// Chrome Trace Event format, it can be loaded in 'chrome://tracing' or Perfetto
+
+#define TRACE_LANE_MAIN 0
+
+typedef struct Trace_Event {
+	char* name;
+	const char* category;
+	size_t lane;
+	uint64_t startUs;
+	uint64_t endUs;
+	bool hasStats;
+	Process_Stats stats;
+} Trace_Event;
+
+typedef struct Trace {
+	Trace_Event* events;
+	size_t size;
+	size_t capacity;
+	size_t laneCount;
+	uint64_t originUs;
+	bool enabled;
+} Trace;
+
+typedef struct Trace_Phase {
+	char* name;
+	uint64_t startUs;
+	Process_Stats startStats;
+} Trace_Phase;
+
+Trace CreateTrace(bool enabled, size_t laneCount)
+{
+	Trace trace = {
+		.laneCount = laneCount,
+		.originUs = GetTimeUs(),
+		.enabled = enabled,
+	};
+
+	return trace;
+}
+
+void TraceAddSpan(Trace* trace, char* name, const char* category, size_t lane, uint64_t startUs, uint64_t endUs, Process_Stats* stats)
+{
+	if (!trace->enabled)
+		return;
+
+	if (trace->size >= trace->capacity) {
+		trace->capacity = trace->capacity > 0 ? trace->capacity * 2 : 256;
+		trace->events = (Trace_Event*) realloc(trace->events, sizeof(Trace_Event) * trace->capacity);
+	}
+
+	size_t nameLen = StrLen(name);
+	Trace_Event* event = &trace->events[trace->size];
+	event->name = (char*) malloc(nameLen + 1);
+	MemCpy(event->name, name, nameLen + 1);
+	event->category = category;
+	event->lane = lane;
+	event->startUs = startUs;
+	event->endUs = endUs;
+	event->hasStats = stats != NULL;
+	if (stats != NULL)
+		event->stats = *stats;
+
+	trace->size += 1;
+}
+
+Trace_Phase TraceBeginPhase(Trace* trace, char* name)
+{
+	Trace_Phase phase = { .name = name };
+	if (trace->enabled)
+		GetSelfStats(&phase.startStats);
+	phase.startUs = GetTimeUs();
+
+	return phase;
+}
+
+void TraceEndPhase(Trace* trace, Trace_Phase* phase)
+{
+	if (!trace->enabled)
+		return;
+
+	uint64_t endUs = GetTimeUs();
+
+	// Only what CBuilder itself spent during the phase, not its children
+	Process_Stats endStats = {0};
+	GetSelfStats(&endStats);
+	endStats.userTimeUs -= phase->startStats.userTimeUs;
+	endStats.sysTimeUs  -= phase->startStats.sysTimeUs;
+
+	TraceAddSpan(trace, phase->name, "phase", TRACE_LANE_MAIN, phase->startUs, endUs, &endStats);
+}
+
+void WriteJsonString(FILE* file, char* str)
+{
+	fputc('\"', file);
+	for (size_t i = 0; str[i] != '\0'; i += 1) {
+		char c = str[i];
+		if (c == '\"' || c == '\\')
+			fprintf(file, "\\%c", c);
+		else if ((unsigned char) c < 0x20)
+			fprintf(file, "\\u%04x", (unsigned int) c);
+		else
+			fputc(c, file);
+	}
+	fputc('\"', file);
+}
+
+bool WriteTrace(Trace* trace, char* path)
+{
+	FILE* file = fopen(path, "w");
+	if (file == NULL)
+		return false;
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"CBuilder\"}}");
+	for (size_t i = 0; i <= trace->laneCount; i += 1) {
+		fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":", i);
+		if (i == TRACE_LANE_MAIN)
+			fprintf(file, "\"CBuilder\"}}");
+		else
+			fprintf(file, "\"Slot %zu\"}}", i);
+	}
+
+	for (size_t i = 0; i < trace->size; i += 1) {
+		Trace_Event* event = &trace->events[i];
+		uint64_t startUs = event->startUs - trace->originUs;
+		uint64_t durUs = event->endUs - event->startUs;
+
+		fprintf(file, ",\n{\"name\":");
+		WriteJsonString(file, event->name);
+		fprintf(file, ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,\"ts\":%llu,\"dur\":%llu",
+			event->category, event->lane, (unsigned long long) startUs, (unsigned long long) durUs);
+
+		if (event->hasStats) {
+			fprintf(file, ",\"args\":{\"userMs\":%.3f,\"sysMs\":%.3f,\"maxRssKb\":%llu,\"ioReadKb\":%llu,\"ioWriteKb\":%llu",
+				(double) event->stats.userTimeUs / 1000.0, (double) event->stats.sysTimeUs / 1000.0,
+				(unsigned long long) event->stats.maxRssKb, (unsigned long long) event->stats.ioReadKb,
+				(unsigned long long) event->stats.ioWriteKb);
+			if (!StrCmp(event->category, "phase"))
+				fprintf(file, ",\"exitCode\":%d", event->stats.exitCode);
+			if (event->stats.oomKilled)
+				fprintf(file, ",\"oomKilled\":true");
+			fprintf(file, "}");
+		}
+
+		fprintf(file, "}");
+	}
+
+	fprintf(file, "\n]}\n");
+
+	bool written = !ferror(file);
+	return (fclose(file) == 0) && written;
+}
+
+void DestroyTrace(Trace* trace)
+{
+	for (size_t i = 0; i < trace->size; i += 1)
+		free(trace->events[i].name);
+
+	free(trace->events);
+	trace->events = NULL;
+	trace->size = 0;
+	trace->capacity = 0;
+}
@@ -0,0 +1,430 @@
+// Compiles preprocessed units for CBuilder's distributed builds, see 'Remote.c' for the protocol.
+// Every unit runs in its own process and temp dir. At most '--jobs' of them compile at once, up to '--queue' more are
+// received while they wait for a job, the rest are told the worker is busy. Units arrive through the socket and go
+// to the compiler through a pipe, they never touch the disk.
+// Only the compilers in '--allow' are run and never through a shell, but the flags are the client's: only listen
+// where the clients are trusted.
+// Usage:
+//	CBuilderWorker [--listen addr] [--port N] [--jobs N] [--queue N] [--allow gcc,cc,clang]
+
+#define _GNU_SOURCE
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <netdb.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/sysinfo.h>
+#include <sys/wait.h>
+
+#define StrLen(str) strlen(str)
+#define StrCmp(s1, s2) (strcmp(s1, s2) == 0)
+
+#define WORKER_MAGIC "CBW3"
+#define WORKER_MAX_ARG_BYTES (256 * 1024)
+#define WORKER_MAX_ARGS 4096
+#define WORKER_MAX_UNIT_SIZE (1024ull * 1024 * 1024)
+
+typedef struct Worker_Config {
+	char* listen;
+	char* port;
+	size_t jobs;
+	size_t queue;
+	char* allow;
+	// One byte per job, a unit takes one before compiling and puts it back after
+	int jobTokens[2];
+} Worker_Config;
+
+static bool SendAll(int sock, const char* data, size_t size)
+{
+	while (size > 0) {
+		ssize_t sent = send(sock, data, size, MSG_NOSIGNAL);
+		if (sent <= 0) {
+			if (sent == -1 && errno == EINTR)
+				continue;
+			return false;
+		}
+
+		data += sent;
+		size -= (size_t) sent;
+	}
+
+	return true;
+}
+
+static bool RecvAll(int sock, char* data, size_t size)
+{
+	while (size > 0) {
+		ssize_t received = recv(sock, data, size, 0);
+		if (received <= 0) {
+			if (received == -1 && errno == EINTR)
+				continue;
+			return false;
+		}
+
+		data += received;
+		size -= (size_t) received;
+	}
+
+	return true;
+}
+
+static bool RecvLine(int sock, char* line, size_t capacity)
+{
+	for (size_t i = 0; i + 1 < capacity; i += 1) {
+		if (!RecvAll(sock, &line[i], 1))
+			return false;
+
+		if (line[i] == '\n') {
+			line[i] = '\0';
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Chunks of '<hex size>\n' and the bytes, an empty one ends the unit. A connection that closes before it was
+// cut short, by a failed preprocessor or a client that went away, so the unit is dropped.
+static char* RecvUnit(int sock, size_t* size)
+{
+	size_t used = 0;
+	size_t capacity = 256 * 1024;
+	char* data = (char*) malloc(capacity);
+	while (true) {
+		char header[32];
+		char* headerEnd = NULL;
+		if (!RecvLine(sock, header, sizeof(header)))
+			break;
+		size_t chunkSize = (size_t) strtoull(header, &headerEnd, 16);
+		if (headerEnd == header || *headerEnd != '\0' || chunkSize > WORKER_MAX_UNIT_SIZE - used)
+			break;
+
+		if (chunkSize == 0) {
+			*size = used;
+			return data;
+		}
+
+		while (used + chunkSize > capacity) {
+			capacity *= 2;
+			data = (char*) realloc(data, capacity);
+		}
+		if (!RecvAll(sock, &data[used], chunkSize))
+			break;
+
+		used += chunkSize;
+	}
+
+	free(data);
+	return NULL;
+}
+
+static void TakeJobToken(Worker_Config* config)
+{
+	char token = 0;
+	while (read(config->jobTokens[0], &token, 1) == -1 && errno == EINTR);
+}
+
+static void ReturnJobToken(Worker_Config* config)
+{
+	char token = 0;
+	while (write(config->jobTokens[1], &token, 1) == -1 && errno == EINTR);
+}
+
+// The unit goes through the compiler's stdin, the language comes from the extension the client sent
+static int CompileUnit(char** argv, size_t argCount, char* ext, char* unit, size_t unitSize, char* objPath, char* logPath)
+{
+	argv[argCount + 0] = "-c";
+	argv[argCount + 1] = "-o";
+	argv[argCount + 2] = objPath;
+	argv[argCount + 3] = "-x";
+	argv[argCount + 4] = StrCmp(ext, ".i") ? "cpp-output" : "c++-cpp-output";
+	argv[argCount + 5] = "-";
+	argv[argCount + 6] = NULL;
+
+	int pipeFds[2];
+	if (pipe(pipeFds) != 0)
+		return 1;
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		int logFd = open(logPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		dup2(pipeFds[0], STDIN_FILENO);
+		dup2(logFd, STDOUT_FILENO);
+		dup2(logFd, STDERR_FILENO);
+		close(pipeFds[0]);
+		close(pipeFds[1]);
+		signal(SIGPIPE, SIG_DFL);
+		execvp(argv[0], argv);
+		fprintf(stderr, "Error trying to run '%s' on the worker\n", argv[0]);
+		_exit(127);
+	}
+	close(pipeFds[0]);
+
+	// A compiler that exits early only makes the writes fail, its exit code is what gets reported
+	for (size_t written = 0; pid != -1 && written < unitSize;) {
+		ssize_t result = write(pipeFds[1], &unit[written], unitSize - written);
+		if (result == -1 && errno == EINTR)
+			continue;
+		if (result <= 0)
+			break;
+
+		written += (size_t) result;
+	}
+	close(pipeFds[1]);
+
+	int status = 0;
+	if (pid == -1 || waitpid(pid, &status, 0) == -1)
+		return 1;
+
+	return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+static char* ReadWholeFile(char* path, size_t* size)
+{
+	*size = 0;
+	FILE* file = fopen(path, "rb");
+	if (file == NULL)
+		return NULL;
+
+	fseek(file, 0, SEEK_END);
+	long fileSize = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	char* data = (char*) malloc(fileSize > 0 ? (size_t) fileSize : 1);
+	if (fileSize > 0 && fread(data, 1, (size_t) fileSize, file) != (size_t) fileSize) {
+		free(data);
+		fclose(file);
+		return NULL;
+	}
+	fclose(file);
+
+	*size = (size_t) fileSize;
+	return data;
+}
+
+static bool SendReply(int sock, int exitCode, const char* log, size_t logSize, const char* obj, size_t objSize)
+{
+	char header[128];
+	int headerLen = snprintf(header, sizeof(header), WORKER_MAGIC " %d %zu %zu\n", exitCode, logSize, objSize);
+
+	return SendAll(sock, header, (size_t) headerLen) && SendAll(sock, log, logSize) && SendAll(sock, obj, objSize);
+}
+
+static bool IsCompilerAllowed(char* allow, char* compiler)
+{
+	size_t compilerLen = StrLen(compiler);
+	for (char* entry = allow; *entry != '\0';) {
+		while (*entry == ',' || *entry == ' ')
+			entry += 1;
+
+		size_t entryLen = strcspn(entry, ", ");
+		if (entryLen > 0 && entryLen == compilerLen && strncmp(entry, compiler, compilerLen) == 0)
+			return true;
+
+		entry += entryLen;
+	}
+
+	return false;
+}
+
+// Runs in its own process, a failure only ever affects this one unit
+static int HandleUnit(int sock, Worker_Config* config)
+{
+	if (!SendAll(sock, "OK\n", 3))
+		return -1;
+
+	char header[256];
+	char ext[16] = {0};
+	size_t argCount = 0;
+	size_t argBytes = 0;
+	if (!RecvLine(sock, header, sizeof(header)) ||
+		sscanf(header, WORKER_MAGIC " %zu %zu %15s", &argCount, &argBytes, ext) != 3)
+		return -1;
+
+	if (argCount == 0 || argCount > WORKER_MAX_ARGS || argBytes > WORKER_MAX_ARG_BYTES || (!StrCmp(ext, ".i") && !StrCmp(ext, ".ii")))
+		return -1;
+
+	char* argData = (char*) malloc(argBytes + 1);
+	if (!RecvAll(sock, argData, argBytes))
+		return -1;
+	argData[argBytes] = '\0';
+
+	char** argv = (char**) malloc(sizeof(char*) * (argCount + 7));
+	char* arg = argData;
+	for (size_t i = 0; i < argCount; i += 1) {
+		if (arg >= &argData[argBytes])
+			return -1;
+
+		argv[i] = arg;
+		arg += StrLen(arg) + 1;
+	}
+
+	if (!IsCompilerAllowed(config->allow, argv[0])) {
+		char log[512];
+		int logLen = snprintf(log, sizeof(log), "Compiler '%s' is not allowed on this worker\n", argv[0]);
+		SendReply(sock, 1, log, (size_t) logLen, NULL, 0);
+		return -1;
+	}
+
+	// Queued units are received while they wait, so the client is free to preprocess the next one.
+	// A client whose preprocessor failed closes the connection before the last chunk and the unit is never compiled.
+	size_t unitSize = 0;
+	char* unit = RecvUnit(sock, &unitSize);
+	if (unit == NULL)
+		return -1;
+
+	char tmpDir[] = "/tmp/cbuilder-worker-XXXXXX";
+	if (mkdtemp(tmpDir) == NULL)
+		return -1;
+
+	char objPath[PATH_MAX];
+	char logPath[PATH_MAX];
+	snprintf(objPath, sizeof(objPath), "%s/unit.o", tmpDir);
+	snprintf(logPath, sizeof(logPath), "%s/unit.log", tmpDir);
+
+	TakeJobToken(config);
+	int exitCode = CompileUnit(argv, argCount, ext, unit, unitSize, objPath, logPath);
+	ReturnJobToken(config);
+	free(unit);
+
+	size_t logSize = 0;
+	size_t objSize = 0;
+	char* log = ReadWholeFile(logPath, &logSize);
+	char* obj = (exitCode == 0) ? ReadWholeFile(objPath, &objSize) : NULL;
+	if (exitCode == 0 && obj == NULL)
+		exitCode = 1;
+
+	bool sent = SendReply(sock, exitCode, log, logSize, obj, objSize);
+
+	unlink(objPath);
+	unlink(logPath);
+	rmdir(tmpDir);
+
+	return sent ? 0 : -1;
+}
+
+static int OpenListenSocket(Worker_Config* config)
+{
+	struct addrinfo hints = {0};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+
+	struct addrinfo* addrs = NULL;
+	if (getaddrinfo(config->listen, config->port, &hints, &addrs) != 0)
+		return -1;
+
+	int sock = -1;
+	for (struct addrinfo* addr = addrs; addr != NULL && sock == -1; addr = addr->ai_next) {
+		sock = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+		if (sock == -1)
+			continue;
+
+		int reuse = 1;
+		setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+		if (bind(sock, addr->ai_addr, addr->ai_addrlen) != 0 || listen(sock, 64) != 0) {
+			close(sock);
+			sock = -1;
+		}
+	}
+
+	freeaddrinfo(addrs);
+
+	return sock;
+}
+
+int main(int argc, char* argv[])
+{
+	Worker_Config config = {
+		.listen = "127.0.0.1",
+		.port = "7878",
+		.jobs = (size_t) get_nprocs(),
+		.allow = "gcc,cc,clang,g++,c++,clang++",
+	};
+
+	for (int i = 1; i < argc; i += 1) {
+		if (StrCmp(argv[i], "--listen") && i + 1 < argc)
+			config.listen = argv[++i];
+		else if (StrCmp(argv[i], "--port") && i + 1 < argc)
+			config.port = argv[++i];
+		else if (StrCmp(argv[i], "--jobs") && i + 1 < argc)
+			config.jobs = (size_t) strtoull(argv[++i], NULL, 10);
+		else if (StrCmp(argv[i], "--queue") && i + 1 < argc)
+			config.queue = (size_t) strtoull(argv[++i], NULL, 10);
+		else if (StrCmp(argv[i], "--allow") && i + 1 < argc)
+			config.allow = argv[++i];
+		else {
+			fprintf(stderr, "Usage: %s [--listen addr] [--port N] [--jobs N] [--queue N] [--allow gcc,cc,clang]\n", argv[0]);
+			return -1;
+		}
+	}
+
+	if (config.jobs == 0)
+		config.jobs = 1;
+	if (config.queue == 0)
+		config.queue = config.jobs;
+
+	if (pipe2(config.jobTokens, O_CLOEXEC) != 0) {
+		fprintf(stderr, "Error trying to create the job tokens\n");
+		return -1;
+	}
+	for (size_t i = 0; i < config.jobs; i += 1)
+		ReturnJobToken(&config);
+
+	// A compiler that exits before reading the whole unit must not take its unit's process with it
+	signal(SIGPIPE, SIG_IGN);
+
+	int listenSock = OpenListenSocket(&config);
+	if (listenSock == -1) {
+		fprintf(stderr, "Error trying to listen on '%s:%s'\n", config.listen, config.port);
+		return -1;
+	}
+	printf("Listening on '%s:%s' with %zu jobs and %zu queued units\n", config.listen, config.port, config.jobs, config.queue);
+	fflush(stdout);
+
+	size_t activeUnits = 0;
+	while (true) {
+		int sock = accept(listenSock, NULL, NULL);
+		if (sock == -1) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "Error trying to accept a connection\n");
+			return -1;
+		}
+
+		// Reaped only now, so the count is exact when it decides whether the worker is busy
+		while (activeUnits > 0 && waitpid(-1, NULL, WNOHANG) > 0)
+			activeUnits -= 1;
+
+		if (activeUnits >= config.jobs + config.queue) {
+			SendAll(sock, "BUSY\n", 5);
+			close(sock);
+			continue;
+		}
+
+		pid_t pid = fork();
+		if (pid == 0) {
+			close(listenSock);
+			int result = HandleUnit(sock, &config);
+			close(sock);
+			_exit(result == 0 ? 0 : 1);
+		}
+
+		close(sock);
+		if (pid != -1)
+			activeUnits += 1;
+	}
+
+	return 0;
+}
@@ -20,6 +20,7 @@ typedef struct ini_t ini_t;
 
 ini_t* ini_create( void* memctx );
 ini_t* ini_load( char const* data, void* memctx );
+ini_t* ini_load_inplace( char* data, void* memctx );
 
 int ini_save( ini_t const* ini, char* data, int size );
 void ini_destroy( ini_t* ini );
@@ -199,6 +200,17 @@ longer needed, it can be destroyed by calling `ini_destroy`. `memctx` is a point
 passed through to the custom INI_MALLOC/INI_FREE calls. It can be NULL if no user defined data is needed.
 
 
+ini_load_inplace
+----------------
+
+    ini_t* ini_load_inplace( char* data, void* memctx )
+
+Same as `ini_load`, but nothing is copied: section names, property names and values are zero-terminated inside `data`
+itself and the returned instance points into it. `data` must be writable, zero-terminated, and stay alive until
+`ini_destroy` is called. This makes it possible to parse a file mapped into memory (copy-on-write) without allocating
+per property.
+
+
 ini_save
 --------
 
@@ -426,20 +438,36 @@ the length is determined automatically, but in this case `value` has to be zero-
 #endif
 
 
+#define INI_INTERNAL_EMPTY_SLOT ( -1 )
+#define INI_INTERNAL_MIN_SLOTS ( 16 )
+#define INI_INTERNAL_SECTION_KEY ( -1 )
+#define INI_INTERNAL_POOL_BLOCK_SIZE ( 4096 )
+
+
+/* open addressing hash table entry, keyed on (section, case folded name) */
+struct ini_internal_slot_t
+    {
+    unsigned int hash;
+    int index;
+    };
+
+
 struct ini_internal_section_t
     {
-    char name[ 32 ];
-    char* name_large;
+    char const* name;
+    int name_length;
+    int* property_list;
+    int property_list_count;
+    int property_list_capacity;
     };
 
 
-struct ini_internal_property_t
+/* strings copied by ini_load/ini_*_add/ini_*_set are bump allocated from a list of blocks */
+struct ini_internal_pool_block_t
     {
-    int section;
-    char name[ 32 ];
-    char* name_large;
-    char value[ 64 ];
-    char* value_large;
+    struct ini_internal_pool_block_t* next;
+    int size;
+    int used;
     };
 
 
@@ -449,33 +477,281 @@ struct ini_t
     int section_capacity;
     int section_count;
 
-    struct ini_internal_property_t* properties;
+    /* properties are stored as parallel arrays, names and values are views into the pool or the in-place buffer */
+    int* property_sections;
+    int* property_ordinals;
+    char const** property_names;
+    int* property_name_lengths;
+    char const** property_values;
+    int* property_value_lengths;
     int property_capacity;
     int property_count;
 
+    struct ini_internal_slot_t* section_slots;
+    int section_slot_capacity;
+
+    struct ini_internal_slot_t* property_slots;
+    int property_slot_capacity;
+
+    struct ini_internal_pool_block_t* pool;
+
     void* memctx;
     };
 
 
+static char const* ini_internal_store( ini_t* ini, char const* str, int length )
+    {
+    struct ini_internal_pool_block_t* block;
+    int size;
+    char* dst;
+
+    block = ini->pool;
+    if( !block || block->size - block->used < length + 1 )
+        {
+        size = length + 1 > INI_INTERNAL_POOL_BLOCK_SIZE ? length + 1 : INI_INTERNAL_POOL_BLOCK_SIZE;
+        block = (struct ini_internal_pool_block_t*) INI_MALLOC( ini->memctx, sizeof( *block ) + (size_t) size );
+        block->size = size;
+        block->used = 0;
+
+        /* a block that only fits this string goes behind the current one, so the current one keeps filling up */
+        if( ini->pool && size > INI_INTERNAL_POOL_BLOCK_SIZE )
+            {
+            block->next = ini->pool->next;
+            ini->pool->next = block;
+            }
+        else
+            {
+            block->next = ini->pool;
+            ini->pool = block;
+            }
+        }
+
+    dst = (char*)( block + 1 ) + block->used;
+    block->used += length + 1;
+    INI_MEMCPY( dst, str, (size_t) length );
+    dst[ length ] = '\0';
+    return dst;
+    }
+
+
 static int ini_internal_property_index( ini_t const* ini, int section, int property )
     {
+    if( ini && section >= 0 && section < ini->section_count )
+        {
+        if( property >= 0 && property < ini->sections[ section ].property_list_count )
+            return ini->sections[ section ].property_list[ property ];
+        }
+
+    return INI_NOT_FOUND;
+    }
+
+
+static unsigned int ini_internal_hash( int section, char const* name, int length )
+    {
+    unsigned int hash;
     int i;
-    int p;
+    char c;
 
-    if( ini && section >= 0 && section < ini->section_count )
+    /* FNV-1a over the ASCII case folded name, so it agrees with INI_STRNICMP */
+    hash = 2166136261u;
+    hash = ( hash ^ (unsigned int) section ) * 16777619u;
+    for( i = 0; i < length; ++i )
         {
-        p = 0;
-        for( i = 0; i < ini->property_count; ++i )
+        c = name[ i ];
+        if( c >= 'A' && c <= 'Z' ) c = (char)( c - 'A' + 'a' );
+        hash = ( hash ^ (unsigned char) c ) * 16777619u;
+        }
+
+    return hash;
+    }
+
+
+static void ini_internal_slot_insert( struct ini_internal_slot_t* slots, int capacity, unsigned int hash, int index )
+    {
+    int i;
+
+    i = (int)( hash & (unsigned int)( capacity - 1 ) );
+    while( slots[ i ].index != INI_INTERNAL_EMPTY_SLOT )
+        i = ( i + 1 ) & ( capacity - 1 );
+
+    slots[ i ].hash = hash;
+    slots[ i ].index = index;
+    }
+
+
+static struct ini_internal_slot_t* ini_internal_slots_reserve( ini_t* ini, struct ini_internal_slot_t* slots,
+    int* capacity, int count )
+    {
+    int i;
+    int new_capacity;
+
+    (void) ini;
+    new_capacity = *capacity;
+    if( new_capacity < INI_INTERNAL_MIN_SLOTS ) new_capacity = INI_INTERNAL_MIN_SLOTS;
+    while( new_capacity < count * 2 ) new_capacity *= 2;
+
+    if( new_capacity != *capacity )
+        {
+        if( slots ) INI_FREE( ini->memctx, slots );
+        slots = (struct ini_internal_slot_t*) INI_MALLOC( ini->memctx, new_capacity * sizeof( slots[ 0 ] ) );
+        *capacity = new_capacity;
+        }
+
+    for( i = 0; i < new_capacity; ++i )
+        slots[ i ].index = INI_INTERNAL_EMPTY_SLOT;
+
+    return slots;
+    }
+
+
+static void ini_internal_property_list_add( ini_t* ini, int section, int property )
+    {
+    struct ini_internal_section_t* sec;
+    int* new_list;
+
+    sec = &ini->sections[ section ];
+    if( sec->property_list_count >= sec->property_list_capacity )
+        {
+        sec->property_list_capacity = sec->property_list_capacity ? sec->property_list_capacity * 2 : 8;
+        new_list = (int*) INI_MALLOC( ini->memctx, sec->property_list_capacity * sizeof( new_list[ 0 ] ) );
+        if( sec->property_list )
             {
-            if( ini->properties[ i ].section == section )
-                {
-                if( p == property ) return i;
-                ++p;
-                }
+            INI_MEMCPY( new_list, sec->property_list, sec->property_list_count * sizeof( new_list[ 0 ] ) );
+            INI_FREE( ini->memctx, sec->property_list );
             }
+        sec->property_list = new_list;
         }
 
-    return INI_NOT_FOUND;
+    ini->property_ordinals[ property ] = sec->property_list_count;
+    sec->property_list[ sec->property_list_count++ ] = property;
+    }
+
+
+/* Rebuilds the lookup tables from scratch, inserting in index order so that the first match of duplicated names is
+   still the one with the lowest index. Used when the tables grow and after removing or renaming entries. */
+static void ini_internal_rebuild_index( ini_t* ini )
+    {
+    int i;
+
+    ini->section_slots = ini_internal_slots_reserve( ini, ini->section_slots, &ini->section_slot_capacity,
+        ini->section_count );
+    for( i = 0; i < ini->section_count; ++i )
+        {
+        ini_internal_slot_insert( ini->section_slots, ini->section_slot_capacity,
+            ini_internal_hash( INI_INTERNAL_SECTION_KEY, ini->sections[ i ].name, ini->sections[ i ].name_length ), i );
+        ini->sections[ i ].property_list_count = 0;
+        }
+
+    ini->property_slots = ini_internal_slots_reserve( ini, ini->property_slots, &ini->property_slot_capacity,
+        ini->property_count );
+    for( i = 0; i < ini->property_count; ++i )
+        {
+        ini_internal_property_list_add( ini, ini->property_sections[ i ], i );
+        ini_internal_slot_insert( ini->property_slots, ini->property_slot_capacity,
+            ini_internal_hash( ini->property_sections[ i ], ini->property_names[ i ], ini->property_name_lengths[ i ] ), i );
+        }
+    }
+
+
+static void* ini_internal_grow_array( ini_t* ini, void* array, int count, int new_capacity, size_t element_size )
+    {
+    void* new_array;
+
+    (void) ini;
+    new_array = INI_MALLOC( ini->memctx, (size_t) new_capacity * element_size );
+    if( array )
+        {
+        INI_MEMCPY( new_array, array, (size_t) count * element_size );
+        INI_FREE( ini->memctx, array );
+        }
+
+    return new_array;
+    }
+
+
+static void ini_internal_property_reserve( ini_t* ini, int capacity )
+    {
+    int count;
+
+    if( capacity <= ini->property_capacity ) return;
+
+    count = ini->property_count;
+    ini->property_sections = (int*) ini_internal_grow_array( ini, ini->property_sections, count, capacity, sizeof( int ) );
+    ini->property_ordinals = (int*) ini_internal_grow_array( ini, ini->property_ordinals, count, capacity, sizeof( int ) );
+    ini->property_names = (char const**) ini_internal_grow_array( ini, ini->property_names, count, capacity, sizeof( char const* ) );
+    ini->property_name_lengths = (int*) ini_internal_grow_array( ini, ini->property_name_lengths, count, capacity, sizeof( int ) );
+    ini->property_values = (char const**) ini_internal_grow_array( ini, ini->property_values, count, capacity, sizeof( char const* ) );
+    ini->property_value_lengths = (int*) ini_internal_grow_array( ini, ini->property_value_lengths, count, capacity, sizeof( int ) );
+    ini->property_capacity = capacity;
+    }
+
+
+/* 'copy' is false when name and value already are zero-terminated views that outlive the ini_t */
+static int ini_internal_section_add( ini_t* ini, char const* name, int length, int copy )
+    {
+    int s;
+
+    if( ini->section_count >= ini->section_capacity )
+        {
+        ini->sections = (struct ini_internal_section_t*) ini_internal_grow_array( ini, ini->sections,
+            ini->section_count, ini->section_capacity * 2, sizeof( ini->sections[ 0 ] ) );
+        ini->section_capacity *= 2;
+        }
+
+    s = ini->section_count;
+    ini->sections[ s ].name = copy ? ini_internal_store( ini, name, length ) : name;
+    ini->sections[ s ].name_length = length;
+    ini->sections[ s ].property_list = 0;
+    ini->sections[ s ].property_list_count = 0;
+    ini->sections[ s ].property_list_capacity = 0;
+
+    ++ini->section_count;
+    if( ini->section_count * 2 > ini->section_slot_capacity )
+        ini_internal_rebuild_index( ini );
+    else
+        ini_internal_slot_insert( ini->section_slots, ini->section_slot_capacity,
+            ini_internal_hash( INI_INTERNAL_SECTION_KEY, name, length ), s );
+
+    return s;
+    }
+
+
+static void ini_internal_property_add( ini_t* ini, int section, char const* name, int name_length, char const* value,
+    int value_length, int copy )
+    {
+    int p;
+
+    if( ini->property_count >= ini->property_capacity )
+        ini_internal_property_reserve( ini, ini->property_capacity * 2 );
+
+    p = ini->property_count;
+    ini->property_sections[ p ] = section;
+    ini->property_names[ p ] = copy ? ini_internal_store( ini, name, name_length ) : name;
+    ini->property_name_lengths[ p ] = name_length;
+    ini->property_values[ p ] = copy ? ini_internal_store( ini, value, value_length ) : value;
+    ini->property_value_lengths[ p ] = value_length;
+
+    ++ini->property_count;
+    if( ini->property_count * 2 > ini->property_slot_capacity )
+        {
+        ini_internal_rebuild_index( ini );
+        }
+    else
+        {
+        ini_internal_property_list_add( ini, section, p );
+        ini_internal_slot_insert( ini->property_slots, ini->property_slot_capacity,
+            ini_internal_hash( section, name, name_length ), p );
+        }
+    }
+
+
+static void ini_internal_property_move( ini_t* ini, int dst, int src )
+    {
+    ini->property_sections[ dst ] = ini->property_sections[ src ];
+    ini->property_names[ dst ] = ini->property_names[ src ];
+    ini->property_name_lengths[ dst ] = ini->property_name_lengths[ src ];
+    ini->property_values[ dst ] = ini->property_values[ src ];
+    ini->property_value_lengths[ dst ] = ini->property_value_lengths[ src ];
     }
 
 
@@ -485,19 +761,35 @@ ini_t* ini_create( void* memctx )
 
     ini = (ini_t*) INI_MALLOC( memctx, sizeof( ini_t ) );
     ini->memctx = memctx;
+    ini->pool = 0;
     ini->sections = (struct ini_internal_section_t*) INI_MALLOC( ini->memctx, INITIAL_CAPACITY * sizeof( ini->sections[ 0 ] ) );
     ini->section_capacity = INITIAL_CAPACITY;
     ini->section_count = 1; /* global section */
-    ini->sections[ 0 ].name[ 0 ] = '\0';
-    ini->sections[ 0 ].name_large = 0;
-    ini->properties = (struct ini_internal_property_t*) INI_MALLOC( ini->memctx, INITIAL_CAPACITY * sizeof( ini->properties[ 0 ] ) );
-    ini->property_capacity = INITIAL_CAPACITY;
+    ini->sections[ 0 ].name = "";
+    ini->sections[ 0 ].name_length = 0;
+    ini->sections[ 0 ].property_list = 0;
+    ini->sections[ 0 ].property_list_count = 0;
+    ini->sections[ 0 ].property_list_capacity = 0;
+    ini->property_sections = 0;
+    ini->property_ordinals = 0;
+    ini->property_names = 0;
+    ini->property_name_lengths = 0;
+    ini->property_values = 0;
+    ini->property_value_lengths = 0;
+    ini->property_capacity = 0;
     ini->property_count = 0;
+    ini_internal_property_reserve( ini, INITIAL_CAPACITY );
+    ini->section_slots = 0;
+    ini->section_slot_capacity = 0;
+    ini->property_slots = 0;
+    ini->property_slot_capacity = 0;
+    ini_internal_rebuild_index( ini );
     return ini;
     }
 
 
-ini_t* ini_load( char const* data, void* memctx )
+/* When 'inplace' is set, 'data' is writable: names and values are terminated inside it instead of being copied */
+static ini_t* ini_internal_load( char const* data, int inplace, void* memctx )
     {
     ini_t* ini;
     char const* ptr;
@@ -537,7 +829,8 @@ ini_t* ini_load( char const* data, void* memctx )
 
                 if( *ptr == ']' )
                     {
-                    s = ini_section_add( ini, start, (int)( ptr - start) );
+                    if( inplace ) *(char*) ptr = '\0';
+                    s = ini_internal_section_add( ini, start, (int)( ptr - start), !inplace );
                     ++ptr;
                     }
                 }
@@ -551,6 +844,7 @@ ini_t* ini_load( char const* data, void* memctx )
                 if( *ptr == '=' )
                     {
                     l = (int)( ptr - start);
+                    if( inplace ) *(char*) ptr = '\0';
                     ++ptr;
                     while( *ptr && *ptr <= ' ' && *ptr != '\n' )
                         ptr++;
@@ -561,9 +855,16 @@ ini_t* ini_load( char const* data, void* memctx )
                         (void)ptr;
                     ptr++;
                     if( ptr == start2 )
-                        ini_property_add( ini, s, start, l, "", 1 );
+                        ini_internal_property_add( ini, s, start, l, "", 0, !inplace );
                     else
-                        ini_property_add( ini, s, start, l, start2, (int)( ptr - start2 ) );
+                        ini_internal_property_add( ini, s, start, l, start2, (int)( ptr - start2 ), !inplace );
+
+                    /* the terminator overwrites whitespace, skip it so the loop doesn't stop there */
+                    if( inplace && *ptr )
+                        {
+                        *(char*) ptr = '\0';
+                        ++ptr;
+                        }
                     }
                 }
             }
@@ -573,13 +874,25 @@ ini_t* ini_load( char const* data, void* memctx )
     }
 
 
+ini_t* ini_load( char const* data, void* memctx )
+    {
+    return ini_internal_load( data, 0, memctx );
+    }
+
+
+ini_t* ini_load_inplace( char* data, void* memctx )
+    {
+    return ini_internal_load( data, 1, memctx );
+    }
+
+
 int ini_save( ini_t const* ini, char* data, int size )
     {
     int s;
     int p;
     int i;
     int l;
-    char* n;
+    char const* n;
     int pos;
 
     if( ini )
@@ -587,8 +900,8 @@ int ini_save( ini_t const* ini, char* data, int size )
         pos = 0;
         for( s = 0; s < ini->section_count; ++s )
             {
-            n = ini->sections[ s ].name_large ? ini->sections[ s ].name_large : ini->sections[ s ].name;
-            l = (int) INI_STRLEN( n );
+            n = ini->sections[ s ].name;
+            l = ini->sections[ s ].name_length;
             if( l > 0 )
                 {
                 if( data && pos < size ) data[ pos ] = '[';
@@ -606,10 +919,10 @@ int ini_save( ini_t const* ini, char* data, int size )
 
             for( p = 0; p < ini->property_count; ++p )
                 {
-                if( ini->properties[ p ].section == s )
+                if( ini->property_sections[ p ] == s )
                     {
-                    n = ini->properties[ p ].name_large ? ini->properties[ p ].name_large : ini->properties[ p ].name;
-                    l = (int) INI_STRLEN( n );
+                    n = ini->property_names[ p ];
+                    l = ini->property_name_lengths[ p ];
                     for( i = 0; i < l; ++i )
                         {
                         if( data && pos < size ) data[ pos ] = n[ i ];
@@ -617,8 +930,8 @@ int ini_save( ini_t const* ini, char* data, int size )
                         }
                     if( data && pos < size ) data[ pos ] = '=';
                     ++pos;
-                    n = ini->properties[ p ].value_large ? ini->properties[ p ].value_large : ini->properties[ p ].value;
-                    l = (int) INI_STRLEN( n );
+                    n = ini->property_values[ p ];
+                    l = ini->property_value_lengths[ p ];
                     for( i = 0; i < l; ++i )
                         {
                         if( data && pos < size ) data[ pos ] = n[ i ];
@@ -649,17 +962,26 @@ int ini_save( ini_t const* ini, char* data, int size )
 void ini_destroy( ini_t* ini )
     {
     int i;
+    struct ini_internal_pool_block_t* block;
+    struct ini_internal_pool_block_t* next;
 
     if( ini )
         {
-        for( i = 0; i < ini->property_count; ++i )
+        for( i = 0; i < ini->section_count; ++i )
+            if( ini->sections[ i ].property_list ) INI_FREE( ini->memctx, ini->sections[ i ].property_list );
+        for( block = ini->pool; block; block = next )
             {
-            if( ini->properties[ i ].value_large ) INI_FREE( ini->memctx, ini->properties[ i ].value_large );
-            if( ini->properties[ i ].name_large ) INI_FREE( ini->memctx, ini->properties[ i ].name_large );
+            next = block->next;
+            INI_FREE( ini->memctx, block );
             }
-        for( i = 0; i < ini->section_count; ++i )
-            if( ini->sections[ i ].name_large ) INI_FREE( ini->memctx, ini->sections[ i ].name_large );
-        INI_FREE( ini->memctx, ini->properties );
+        if( ini->section_slots ) INI_FREE( ini->memctx, ini->section_slots );
+        if( ini->property_slots ) INI_FREE( ini->memctx, ini->property_slots );
+        INI_FREE( ini->memctx, ini->property_sections );
+        INI_FREE( ini->memctx, ini->property_ordinals );
+        INI_FREE( ini->memctx, (void*) ini->property_names );
+        INI_FREE( ini->memctx, ini->property_name_lengths );
+        INI_FREE( ini->memctx, (void*) ini->property_values );
+        INI_FREE( ini->memctx, ini->property_value_lengths );
         INI_FREE( ini->memctx, ini->sections );
         INI_FREE( ini->memctx, ini );
         }
@@ -676,7 +998,7 @@ int ini_section_count( ini_t const* ini )
 char const* ini_section_name( ini_t const* ini, int section )
     {
     if( ini && section >= 0 && section < ini->section_count )
-        return ini->sections[ section ].name_large ? ini->sections[ section ].name_large : ini->sections[ section ].name;
+        return ini->sections[ section ].name;
 
     return NULL;
     }
@@ -684,18 +1006,8 @@ char const* ini_section_name( ini_t const* ini, int section )
 
 int ini_property_count( ini_t const* ini, int section )
     {
-    int i;
-    int count;
-
-    if( ini )
-        {
-        count = 0;
-        for( i = 0; i < ini->property_count; ++i )
-            {
-            if( ini->properties[ i ].section == section ) ++count;
-            }
-        return count;
-        }
+    if( ini && section >= 0 && section < ini->section_count )
+        return ini->sections[ section ].property_list_count;
 
     return 0;
     }
@@ -709,7 +1021,7 @@ char const* ini_property_name( ini_t const* ini, int section, int property )
         {
         p = ini_internal_property_index( ini, section, property );
         if( p != INI_NOT_FOUND )
-            return ini->properties[ p ].name_large ? ini->properties[ p ].name_large : ini->properties[ p ].name;
+            return ini->property_names[ p ];
         }
 
     return NULL;
@@ -724,7 +1036,7 @@ char const* ini_property_value( ini_t const* ini, int section, int property )
         {
         p = ini_internal_property_index( ini, section, property );
         if( p != INI_NOT_FOUND )
-            return ini->properties[ p ].value_large ? ini->properties[ p ].value_large : ini->properties[ p ].value;
+            return ini->property_values[ p ];
         }
 
     return NULL;
@@ -733,17 +1045,24 @@ char const* ini_property_value( ini_t const* ini, int section, int property )
 
 int ini_find_section( ini_t const* ini, char const* name, int name_length )
     {
+    unsigned int hash;
+    int mask;
     int i;
+    int s;
 
     if( ini && name )
         {
         if( name_length <= 0 ) name_length = (int) INI_STRLEN( name );
-        for( i = 0; i < ini->section_count; ++i )
+        hash = ini_internal_hash( INI_INTERNAL_SECTION_KEY, name, name_length );
+        mask = ini->section_slot_capacity - 1;
+        for( i = (int)( hash & (unsigned int) mask ); ini->section_slots[ i ].index != INI_INTERNAL_EMPTY_SLOT; i = ( i + 1 ) & mask )
             {
-            char const* const other =
-                ini->sections[ i ].name_large ? ini->sections[ i ].name_large : ini->sections[ i ].name;
-            if( strlen( other ) == (size_t) name_length && INI_STRNICMP( name, other, (size_t)name_length ) == 0 )
-                return i;
+            if( ini->section_slots[ i ].hash != hash ) continue;
+
+            s = ini->section_slots[ i ].index;
+            if( ini->sections[ s ].name_length == name_length &&
+                INI_STRNICMP( name, ini->sections[ s ].name, (size_t) name_length ) == 0 )
+                return s;
             }
         }
 
@@ -753,23 +1072,24 @@ int ini_find_section( ini_t const* ini, char const* name, int name_length )
 
 int ini_find_property( ini_t const* ini, int section, char const* name, int name_length )
     {
+    unsigned int hash;
+    int mask;
     int i;
-    int c;
+    int p;
 
     if( ini && name && section >= 0 && section < ini->section_count)
         {
         if( name_length <= 0 ) name_length = (int) INI_STRLEN( name );
-        c = 0;
-        for( i = 0; i < ini->property_count; ++i )
+        hash = ini_internal_hash( section, name, name_length );
+        mask = ini->property_slot_capacity - 1;
+        for( i = (int)( hash & (unsigned int) mask ); ini->property_slots[ i ].index != INI_INTERNAL_EMPTY_SLOT; i = ( i + 1 ) & mask )
             {
-            if( ini->properties[ i ].section == section )
-                {
-                char const* const other =
-                    ini->properties[ i ].name_large ? ini->properties[ i ].name_large : ini->properties[ i ].name;
-                if( strlen( other ) == (size_t) name_length && INI_STRNICMP( name, other, (size_t) name_length ) == 0 )
-                    return c;
-                ++c;
-                }
+            if( ini->property_slots[ i ].hash != hash ) continue;
+
+            p = ini->property_slots[ i ].index;
+            if( ini->property_sections[ p ] == section && ini->property_name_lengths[ p ] == name_length &&
+                INI_STRNICMP( name, ini->property_names[ p ], (size_t) name_length ) == 0 )
+                return ini->property_ordinals[ p ];
             }
         }
 
@@ -779,35 +1099,10 @@ int ini_find_property( ini_t const* ini, int section, char const* name, int name
 
 int ini_section_add( ini_t* ini, char const* name, int length )
     {
-    struct ini_internal_section_t* new_sections;
-
     if( ini && name )
         {
         if( length <= 0 ) length = (int) INI_STRLEN( name );
-        if( ini->section_count >= ini->section_capacity )
-            {
-            ini->section_capacity *= 2;
-            new_sections = (struct ini_internal_section_t*) INI_MALLOC( ini->memctx,
-                ini->section_capacity * sizeof( ini->sections[ 0 ] ) );
-            INI_MEMCPY( new_sections, ini->sections, ini->section_count * sizeof( ini->sections[ 0 ] ) );
-            INI_FREE( ini->memctx, ini->sections );
-            ini->sections = new_sections;
-            }
-
-        ini->sections[ ini->section_count ].name_large = 0;
-        if( (size_t) length + 1 >= sizeof( ini->sections[ 0 ].name ) )
-            {
-            ini->sections[ ini->section_count ].name_large = (char*) INI_MALLOC( ini->memctx, (size_t) length + 1 );
-            INI_MEMCPY( ini->sections[ ini->section_count ].name_large, name, (size_t) length );
-            ini->sections[ ini->section_count ].name_large[ length ] = '\0';
-            }
-        else
-            {
-            INI_MEMCPY( ini->sections[ ini->section_count ].name, name, (size_t) length );
-            ini->sections[ ini->section_count ].name[ length ] = '\0';
-            }
-
-        return ini->section_count++;
+        return ini_internal_section_add( ini, name, length, 1 );
         }
     return INI_NOT_FOUND;
     }
@@ -815,81 +1110,38 @@ int ini_section_add( ini_t* ini, char const* name, int length )
 
 void ini_property_add( ini_t* ini, int section, char const* name, int name_length, char const* value, int value_length )
     {
-    struct ini_internal_property_t* new_properties;
-
     if( ini && name && section >= 0 && section < ini->section_count )
         {
         if( name_length <= 0 ) name_length = (int) INI_STRLEN( name );
         if( value_length <= 0 ) value_length = (int) INI_STRLEN( value );
-
-        if( ini->property_count >= ini->property_capacity )
-            {
-
-            ini->property_capacity *= 2;
-            new_properties = (struct ini_internal_property_t*) INI_MALLOC( ini->memctx,
-                ini->property_capacity * sizeof( ini->properties[ 0 ] ) );
-            INI_MEMCPY( new_properties, ini->properties, ini->property_count * sizeof( ini->properties[ 0 ] ) );
-            INI_FREE( ini->memctx, ini->properties );
-            ini->properties = new_properties;
-            }
-
-        ini->properties[ ini->property_count ].section = section;
-        ini->properties[ ini->property_count ].name_large = 0;
-        ini->properties[ ini->property_count ].value_large = 0;
-
-        if( (size_t) name_length + 1 >= sizeof( ini->properties[ 0 ].name ) )
-            {
-            ini->properties[ ini->property_count ].name_large = (char*) INI_MALLOC( ini->memctx, (size_t) name_length + 1 );
-            INI_MEMCPY( ini->properties[ ini->property_count ].name_large, name, (size_t) name_length );
-            ini->properties[ ini->property_count ].name_large[ name_length ] = '\0';
-            }
-        else
-            {
-            INI_MEMCPY( ini->properties[ ini->property_count ].name, name, (size_t) name_length );
-            ini->properties[ ini->property_count ].name[ name_length ] = '\0';
-            }
-
-        if( (size_t) value_length + 1 >= sizeof( ini->properties[ 0 ].value ) )
-            {
-            ini->properties[ ini->property_count ].value_large = (char*) INI_MALLOC( ini->memctx, (size_t) value_length + 1 );
-            INI_MEMCPY( ini->properties[ ini->property_count ].value_large, value, (size_t) value_length );
-            ini->properties[ ini->property_count ].value_large[ value_length ] = '\0';
-            }
-        else
-            {
-            INI_MEMCPY( ini->properties[ ini->property_count ].value, value, (size_t) value_length );
-            ini->properties[ ini->property_count ].value[ value_length ] = '\0';
-            }
-
-        ++ini->property_count;
+        ini_internal_property_add( ini, section, name, name_length, value, value_length, 1 );
         }
     }
 
 
+/* Strings of removed or renamed entries stay in the pool until ini_destroy */
 void ini_section_remove( ini_t* ini, int section )
     {
     int p;
 
     if( ini && section >= 0 && section < ini->section_count )
         {
-        if( ini->sections[ section ].name_large ) INI_FREE( ini->memctx, ini->sections[ section ].name_large );
+        if( ini->sections[ section ].property_list ) INI_FREE( ini->memctx, ini->sections[ section ].property_list );
         for( p = ini->property_count - 1; p >= 0; --p )
             {
-            if( ini->properties[ p ].section == section )
-                {
-                if( ini->properties[ p ].value_large ) INI_FREE( ini->memctx, ini->properties[ p ].value_large );
-                if( ini->properties[ p ].name_large ) INI_FREE( ini->memctx, ini->properties[ p ].name_large );
-                ini->properties[ p ] = ini->properties[ --ini->property_count ];
-                }
+            if( ini->property_sections[ p ] == section )
+                ini_internal_property_move( ini, p, --ini->property_count );
             }
 
         ini->sections[ section ] = ini->sections[ --ini->section_count  ];
 
         for( p = 0; p < ini->property_count; ++p )
             {
-            if( ini->properties[ p ].section == ini->section_count )
-                ini->properties[ p ].section = section;
+            if( ini->property_sections[ p ] == ini->section_count )
+                ini->property_sections[ p ] = section;
             }
+
+        ini_internal_rebuild_index( ini );
         }
     }
 
@@ -903,9 +1155,8 @@ void ini_property_remove( ini_t* ini, int section, int property )
         p = ini_internal_property_index( ini, section, property );
         if( p != INI_NOT_FOUND )
             {
-            if( ini->properties[ p ].value_large ) INI_FREE( ini->memctx, ini->properties[ p ].value_large );
-            if( ini->properties[ p ].name_large ) INI_FREE( ini->memctx, ini->properties[ p ].name_large );
-            ini->properties[ p ] = ini->properties[ --ini->property_count  ];
+            ini_internal_property_move( ini, p, --ini->property_count );
+            ini_internal_rebuild_index( ini );
             return;
             }
         }
@@ -917,20 +1168,9 @@ void ini_section_name_set( ini_t* ini, int section, char const* name, int length
     if( ini && name && section >= 0 && section < ini->section_count )
         {
         if( length <= 0 ) length = (int) INI_STRLEN( name );
-        if( ini->sections[ section ].name_large ) INI_FREE( ini->memctx, ini->sections[ section ].name_large );
-        ini->sections[ section ].name_large = 0;
-
-        if( (size_t) length + 1 >= sizeof( ini->sections[ 0 ].name ) )
-            {
-            ini->sections[ section ].name_large = (char*) INI_MALLOC( ini->memctx, (size_t) length + 1 );
-            INI_MEMCPY( ini->sections[ section ].name_large, name, (size_t) length );
-            ini->sections[ section ].name_large[ length ] = '\0';
-            }
-        else
-            {
-            INI_MEMCPY( ini->sections[ section ].name, name, (size_t) length );
-            ini->sections[ section ].name[ length ] = '\0';
-            }
+        ini->sections[ section ].name = ini_internal_store( ini, name, length );
+        ini->sections[ section ].name_length = length;
+        ini_internal_rebuild_index( ini );
         }
     }
 
@@ -945,20 +1185,9 @@ void ini_property_name_set( ini_t* ini, int section, int property, char const* n
         p = ini_internal_property_index( ini, section, property );
         if( p != INI_NOT_FOUND )
             {
-            if( ini->properties[ p ].name_large ) INI_FREE( ini->memctx, ini->properties[ p ].name_large );
-            ini->properties[ ini->property_count ].name_large = 0;
-
-            if( (size_t) length + 1 >= sizeof( ini->properties[ 0 ].name ) )
-                {
-                ini->properties[ p ].name_large = (char*) INI_MALLOC( ini->memctx, (size_t) length + 1 );
-                INI_MEMCPY( ini->properties[ p ].name_large, name, (size_t) length );
-                ini->properties[ p ].name_large[ length ] = '\0';
-                }
-            else
-                {
-                INI_MEMCPY( ini->properties[ p ].name, name, (size_t) length );
-                ini->properties[ p ].name[ length ] = '\0';
-                }
+            ini->property_names[ p ] = ini_internal_store( ini, name, length );
+            ini->property_name_lengths[ p ] = length;
+            ini_internal_rebuild_index( ini );
             }
         }
     }
@@ -974,20 +1203,8 @@ void ini_property_value_set( ini_t* ini, int section, int property, char const*
         p = ini_internal_property_index( ini, section, property );
         if( p != INI_NOT_FOUND )
             {
-            if( ini->properties[ p ].value_large ) INI_FREE( ini->memctx, ini->properties[ p ].value_large );
-            ini->properties[ ini->property_count ].value_large = 0;
-
-            if( (size_t) length + 1 >= sizeof( ini->properties[ 0 ].value ) )
-                {
-                ini->properties[ p ].value_large = (char*) INI_MALLOC( ini->memctx, (size_t) length + 1 );
-                INI_MEMCPY( ini->properties[ p ].value_large, value, (size_t) length );
-                ini->properties[ p ].value_large[ length ] = '\0';
-                }
-            else
-                {
-                INI_MEMCPY( ini->properties[ p ].value, value, (size_t) length );
-                ini->properties[ p ].value[ length ] = '\0';
-                }
+            ini->property_values[ p ] = ini_internal_store( ini, value, length );
+            ini->property_value_lengths[ p ] = length;
             }
         }
     }
@@ -1002,6 +1219,8 @@ contributors:
     Branimir Karadzic (INI_STRNICMP bugfix)
 
 revision history:
+    1.2.2   (CBuilder) ini_load_inplace, properties stored as parallel arrays of views, strings copied into a pool
+    1.2.1   (CBuilder) hashed section/property lookups, fixed out of bounds write in ini_property_name/value_set
     1.2     using strnicmp for correct length compares, fixed copy-paste bug in ini_property_value_set
     1.1     customization, added documentation, cleanup
     1.0     first publicly released version